@@ -0,0 +1,32 @@
+#!/usr/bin/bash
+
+# Compare native (little-endian) and ordered (big-endian, sign-flipped)
+# int keys: sequential store and sum of n records in the B-tree.
+# Usage: ./bench_keys.sh [n] [threads]
+
+n=${1:-10000000}
+threads=${2:-4}
+line="----------------------------------------------------------------------------"
+
+echo "Compiling......."
+make
+mkdir -p db
+echo $line
+
+for keys in native ordered; do
+    option=""
+    if [ "$keys" = "native" ]; then
+        option="--native-keys"
+    fi
+
+    echo "Key encoding: $keys, records: $n"
+    rm -f db/bench_$keys.db
+    ./main bench_$keys $n $option | grep "Time taken\|Sum ="
+    echo "Parallel sum with $threads threads:"
+    ./main bench_$keys $n $option --threads $threads | grep "Time taken\|Sum =" | tail -2
+    ls -l db/bench_$keys.db | awk '{ print "Database size: " $5 " bytes" }'
+    echo $line
+done
+
+echo "Removing executable file: main"
+make clean
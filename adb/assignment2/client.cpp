@@ -0,0 +1,283 @@
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstring> // memcpy, strerror
+#include <exception>
+#include <iostream>
+#include <random>
+#include <string>
+#include <sys/socket.h>
+#include <sys/un.h> // sockaddr_un
+#include <sys/wait.h> // waitpid
+#include <unistd.h> // read, write, close, fork, pipe
+#include <vector>
+
+#include "protocol.h"
+
+// Load generator for the key-value server: 1, 2, 4, ... client processes
+// each keep a number of requests in flight on their own connection for a
+// fixed time, and the throughput of every client count is reported.
+
+struct ClientConfig {
+    std::string socketPath = DEFAULT_SOCKET_PATH;
+    int maxClients = 8; // Client counts 1, 2, 4, ... up to this
+    double seconds = 2; // Per client count
+    int pipeline = 16; // Requests in flight per client
+    int batch = 1; // Keys per read request: 1 = GET, more = MULTI_GET
+    int recordCount = 100000; // Keys [0, recordCount) are used
+    double writeRatio = 0; // Fraction of requests that are single-key puts
+    bool load = false; // Put recordCount records first
+};
+
+struct ClientResult {
+    long long requests = 0;
+    long long keys = 0;
+};
+
+int connectTo(const std::string& path) {
+    sockaddr_un addr = {};
+    addr.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(addr.sun_path)) {
+        std::cerr << "Error: Socket path " << path << " is too long.\n";
+        std::exit(1);
+    }
+    std::memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 || connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+        std::cerr << "Error: Unable to connect to " << path << ": " << std::strerror(errno) << ".\n";
+        std::exit(1);
+    }
+    return fd;
+}
+
+void writeAll(int fd, const std::vector<char>& data) {
+    for (size_t sent = 0; sent < data.size();) {
+        ssize_t n = ::write(fd, data.data() + sent, data.size() - sent);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            std::cerr << "Error: Connection to server lost.\n";
+            std::exit(1);
+        }
+        sent += n;
+    }
+}
+
+// Read from fd into in, and return the number of complete responses at
+// its front. Exits on a failed request.
+size_t receiveResponses(int fd, std::vector<char>& in) {
+    char buffer[64 * 1024];
+    ssize_t n;
+    while ((n = ::read(fd, buffer, sizeof(buffer))) < 0 && errno == EINTR) {
+    }
+    if (n <= 0) {
+        std::cerr << "Error: Connection to server lost.\n";
+        std::exit(1);
+    }
+    in.insert(in.end(), buffer, buffer + n);
+
+    size_t responses = 0;
+    size_t pos = 0;
+    while (in.size() - pos >= sizeof(MessageHeader)) {
+        MessageHeader header;
+        std::memcpy(&header, in.data() + pos, sizeof(header));
+        if (header.op != STATUS_OK) {
+            std::cerr << "Error: Request rejected by server.\n";
+            std::exit(1);
+        }
+        size_t size = sizeof(header) + header.count * sizeof(int32_t);
+        if (in.size() - pos < size) {
+            break;
+        }
+        pos += size;
+        ++responses;
+    }
+    in.erase(in.begin(), in.begin() + pos);
+    return responses;
+}
+
+// Insert the records in batched puts, one connection
+void loadRecords(const ClientConfig& config) {
+    int fd = connectTo(config.socketPath);
+    std::mt19937 random(std::random_device{}());
+    std::vector<char> out;
+    std::vector<char> in;
+    std::vector<int32_t> payload;
+
+    const int BATCH = 512; // Records per put
+    size_t pending = 0;
+    for (int first = 0; first < config.recordCount; first += BATCH) {
+        payload.clear();
+        for (int k = first; k < std::min(first + BATCH, config.recordCount); ++k) {
+            payload.push_back(k);
+            payload.push_back(random() % INT32_MAX);
+        }
+        out.clear();
+        appendMessage(out, OP_PUT, payload.data(), payload.size());
+        writeAll(fd, out);
+        ++pending;
+    }
+    while (pending > 0) {
+        pending -= receiveResponses(fd, in);
+    }
+    ::close(fd);
+}
+
+// Run in a child process: keep config.pipeline requests in flight until
+// the deadline, then wait for the outstanding ones
+ClientResult runClient(const ClientConfig& config) {
+    int fd = connectTo(config.socketPath);
+    std::mt19937 random(getpid());
+    std::uniform_int_distribution<int> keys(0, config.recordCount - 1);
+    std::uniform_real_distribution<double> pick(0, 1);
+
+    ClientResult result;
+    std::vector<char> out;
+    std::vector<char> in;
+    std::vector<int32_t> payload(std::max(config.batch, 2));
+    auto appendRequest = [&]() {
+        if (pick(random) < config.writeRatio) {
+            payload[0] = keys(random);
+            payload[1] = random() % INT32_MAX;
+            appendMessage(out, OP_PUT, payload.data(), 2);
+            result.keys += 1;
+        } else {
+            for (int i = 0; i < config.batch; ++i) {
+                payload[i] = keys(random);
+            }
+            appendMessage(out, config.batch == 1 ? OP_GET : OP_MULTI_GET, payload.data(), config.batch);
+            result.keys += config.batch;
+        }
+        ++result.requests;
+    };
+
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::duration<double>(config.seconds);
+    int inFlight = 0;
+    for (; inFlight < config.pipeline; ++inFlight) {
+        appendRequest();
+    }
+    writeAll(fd, out);
+
+    while (inFlight > 0) {
+        size_t done = receiveResponses(fd, in);
+        inFlight -= done;
+        if (std::chrono::steady_clock::now() < deadline) {
+            out.clear();
+            for (size_t i = 0; i < done; ++i, ++inFlight) {
+                appendRequest(); // Replace every answered request
+            }
+            writeAll(fd, out);
+        }
+    }
+
+    ::close(fd);
+    return result;
+}
+
+void printUsage(const char* program) {
+    std::cerr << "Usage: " << program << " [options]\n"
+              << "Options:\n"
+              << "  --socket path    Server socket (default " << DEFAULT_SOCKET_PATH << ")\n"
+              << "  --clients n      Run with 1, 2, 4, ... up to n client processes (default 8)\n"
+              << "  --seconds s      Run time per client count (default 2)\n"
+              << "  --pipeline n     Requests in flight per client (default 16)\n"
+              << "  --batch n        Keys per read request, more than 1 uses MULTI_GET (default 1)\n"
+              << "  --records n      Keys [0, n) are used (default 100000)\n"
+              << "  --write p        Fraction of requests that are puts (default 0)\n"
+              << "  --load           Put the records first\n";
+}
+
+int main(const int argc, const char* argv[]) {
+    ClientConfig config;
+    try {
+        for (int i = 1; i < argc; ++i) {
+            std::string option = argv[i];
+            if (option == "--load") {
+                config.load = true;
+                continue;
+            }
+            if (i + 1 >= argc) {
+                throw std::invalid_argument(option);
+            }
+
+            std::string value = argv[++i];
+            if (option == "--socket") {
+                config.socketPath = value;
+            } else if (option == "--clients") {
+                config.maxClients = std::max(1, std::stoi(value));
+            } else if (option == "--seconds") {
+                config.seconds = std::stod(value);
+            } else if (option == "--pipeline") {
+                config.pipeline = std::max(1, std::stoi(value));
+            } else if (option == "--batch") {
+                config.batch = std::max(1, std::min<int>(MAX_PAYLOAD, std::stoi(value)));
+            } else if (option == "--records") {
+                config.recordCount = std::max(1, std::stoi(value));
+            } else if (option == "--write") {
+                config.writeRatio = std::stod(value);
+            } else {
+                throw std::invalid_argument(option);
+            }
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Error: Invalid option " << e.what() << ".\n";
+        printUsage(argv[0]);
+        std::exit(1);
+    }
+
+    if (config.load) {
+        std::cout << "Loading " << config.recordCount << " records..." << std::endl;
+        loadRecords(config);
+    }
+
+    std::cout << "Clients\tRequests/s\tKeys/s\t\tRequests/s per client" << std::endl;
+    for (int clients = 1; clients <= config.maxClients; clients *= 2) {
+        std::vector<int> fds;
+        std::vector<pid_t> children;
+        for (int c = 0; c < clients; ++c) {
+            int pipeFds[2];
+            if (pipe(pipeFds) != 0) {
+                std::cerr << "Error: Unable to create pipe.\n";
+                std::exit(1);
+            }
+
+            std::cout.flush(); // Nothing buffered may be written twice
+            pid_t pid = fork();
+            if (pid < 0) {
+                std::cerr << "Error: Unable to fork.\n";
+                std::exit(1);
+            }
+            if (pid == 0) {
+                ::close(pipeFds[0]);
+                ClientResult result = runClient(config);
+                ::write(pipeFds[1], &result, sizeof(result));
+                _exit(0);
+            }
+            ::close(pipeFds[1]);
+            fds.push_back(pipeFds[0]);
+            children.push_back(pid);
+        }
+
+        ClientResult total;
+        for (int c = 0; c < clients; ++c) {
+            ClientResult result;
+            if (::read(fds[c], &result, sizeof(result)) != sizeof(result)) {
+                std::cerr << "Error: Client process " << children[c] << " failed.\n";
+            } else {
+                total.requests += result.requests;
+                total.keys += result.keys;
+            }
+            ::close(fds[c]);
+            waitpid(children[c], nullptr, 0);
+        }
+
+        std::cout << clients << '\t' << static_cast<long long>(total.requests / config.seconds) << "\t\t"
+                  << static_cast<long long>(total.keys / config.seconds) << "\t\t"
+                  << static_cast<long long>(total.requests / config.seconds / clients) << std::endl;
+    }
+
+    return 0;
+}
@@ -0,0 +1,1114 @@
+#ifndef DATABASE_H
+#define DATABASE_H
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring> // memcpy, memcmp
+#include <db_cxx.h> // Berkeley DB
+#include <exception>
+#include <fcntl.h> // open, posix_fadvise
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <queue>
+#include <shared_mutex>
+#include <string>
+#include <thread>
+#include <unistd.h> // close
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include "storage.h"
+
+enum DbErrorCode {
+    DB_SUCCESS,
+    DB_ERROR
+};
+
+// How int keys are laid out in the B-tree, which compares keys bytewise
+enum class KeyEncoding {
+    ORDERED, // Big-endian with the sign bit flipped: byte order is numeric order
+    NATIVE // Raw host bytes: on little-endian hosts 0, 256, 512... sort together
+};
+
+const size_t KEY_SIZE = sizeof(int);
+
+// Optional features of a Database, fixed when it is opened
+struct DatabaseOptions {
+    size_t cacheSize = 64 * 1024; // Berkeley DB cache (mpool) bytes
+    // B-tree geometry, applied when a database file is created
+    u_int32_t pageSize = 0; // Bytes, power of two in [512, 65536], 0 = Berkeley DB default
+    u_int32_t btreeMinKey = 0; // Minimum keys per page, 0 = default (2)
+    bool recordHotKeys = false; // Record key ranges read, saved at close for warmUp()
+    size_t bufferCapacity = 0; // Write buffer entries, 0 = write through
+    KeyEncoding keyEncoding = KeyEncoding::ORDERED;
+    bool valueIndex = false; // Maintain a secondary index keyed by value
+    int prefixSumCapacity = 0; // Maintain a prefix-sum index over keys [0, capacity), 0 = none
+    // Transactional environment with multiversion pages: sums and scans
+    // read a snapshot while puts go on, and neither waits for the other
+    bool snapshotReads = false;
+    // Engine records are stored in. Indexes, scans and warm-up need Berkeley DB.
+    StorageEngine engine = StorageEngine::BDB;
+};
+
+// Record of the prefix-sum index describing the records its tree was
+// last brought up to date with. Puts made while the index is not open
+// change the records but not the checksum, so the next open rebuilds.
+const std::string PREFIX_META_KEY = "meta";
+struct PrefixMeta {
+    long long capacity; // Keys covered, wide so the record has no padding
+    unsigned long long checksum; // Sum of value * prefixWeight(key) over the covered keys, wrapping
+};
+
+// Keys per recorded hot range, about one leaf page of int records
+const int HOT_KEY_RANGE = 128;
+
+class Database {
+  private:
+    DbEnv* mEnv; // Berkeley DB environment variable
+    Db* mDatabase; // Berkeley DB connection
+    std::string mName;
+    Db* mIndex; // Secondary database keyed by value, or nullptr
+    Db* mPrefix; // Fenwick tree of partial sums, or nullptr
+    int mPrefixCapacity; // Keys covered by mPrefix
+    unsigned long long mPrefixChecksum; // Of the records mPrefix covers, saved on close
+    // Held while a put changes the Fenwick nodes and its record, and while
+    // sum() reads the nodes, so that concurrent puts of the same key or of
+    // keys sharing nodes are not lost. The index covers stored records
+    // only: buffered puts reach it when the buffer is flushed.
+    std::mutex mPrefixLock;
+
+    // Write buffer (memtable): puts are absorbed here in key order and
+    // written to the B-tree in one sorted pass once mBufferCapacity
+    // entries are buffered, and on close. Capacity 0 disables it.
+    std::map<int, int> mBuffer;
+    size_t mBufferCapacity;
+    std::mutex mBufferLock;
+
+    KeyEncoding mKeyEncoding;
+
+    // Start of each key range read, when recording hot keys. Bounded by
+    // the cache size: replaying more ranges than fit would only evict.
+    std::unordered_set<int> mHotKeys;
+    size_t mHotKeyLimit; // 0 = not recording
+    std::mutex mHotKeyLock;
+
+    // Puts hold mSnapshotLock shared; parallelSum() takes it exclusively
+    // for the instant it begins its snapshots, so all of them see one state
+    bool mSnapshotReads;
+    std::shared_mutex mSnapshotLock;
+
+    // Other engine than Berkeley DB, or nullptr. Unlike a DB_THREAD
+    // handle it is not thread-safe, so access is guarded by mStorageLock.
+    Storage* mStorage;
+    std::shared_mutex mStorageLock;
+
+  public:
+    Database(const std::string dbName, const DatabaseOptions& options = DatabaseOptions())
+        : mEnv(nullptr), mDatabase(nullptr), mName(dbName), mIndex(nullptr), mPrefix(nullptr), mPrefixCapacity(0),
+          mPrefixChecksum(0),
+          mBufferCapacity(options.bufferCapacity), mKeyEncoding(options.keyEncoding), mHotKeyLimit(0),
+          mSnapshotReads(options.snapshotReads), mStorage(nullptr) {
+        if (options.engine != StorageEngine::BDB) {
+            if (options.valueIndex || options.prefixSumCapacity != 0 || options.snapshotReads) {
+                std::cerr << "Error: Indexes and snapshot reads need the Berkeley DB storage engine.\n";
+                std::exit(DbErrorCode::DB_ERROR);
+            }
+            std::cout << "Opening database...\n";
+            if (options.engine == StorageEngine::MEMORY) {
+                mStorage = new MemoryStorage(dbName);
+            } else {
+                mStorage = new MmapStorage("./db/" + dbName + ".mmap");
+            }
+            return;
+        }
+
+        const size_t GB = 1 << 30;
+        mEnv = new DbEnv(0); // Berkeley DB Environment
+        mEnv->set_error_stream(&std::cerr); // Set error stream
+        mEnv->set_cachesize(options.cacheSize / GB, options.cacheSize % GB, 0); // Allocate cache memory
+
+        u_int32_t envFlags = DB_CREATE | DB_INIT_MPOOL | DB_THREAD;
+        u_int32_t dbFlags = DB_CREATE | DB_THREAD;
+        if (options.snapshotReads) {
+            // Writers copy pages in the cache instead of locking readers
+            // out. Puts outside a transaction commit on their own.
+            envFlags |= DB_INIT_TXN | DB_INIT_LOCK | DB_INIT_LOG;
+            dbFlags |= DB_MULTIVERSION;
+            mEnv->set_flags(DB_AUTO_COMMIT, 1);
+            mEnv->set_lk_detect(DB_LOCK_DEFAULT); // Break deadlocks between writers
+        }
+
+        try {
+            mEnv->open("./db", envFlags, 0); // Open environment
+        } catch (const DbException& e) {
+            std::cerr << "Error: Unable to open db.\n";
+            std::cerr << e.what() << std::endl;
+            std::exit(DbErrorCode::DB_ERROR);
+        } catch (const std::exception& e) {
+            std::cerr << "Error: Unable to create environment.\n";
+            std::cerr << e.what() << std::endl;
+            std::exit(DbErrorCode::DB_ERROR);
+        }
+
+        std::cout << "Opening database...\n";
+        try {
+            mDatabase = new Db(mEnv, 0); // Database
+            setGeometry(mDatabase, options);
+            // Open the database
+            mDatabase->open(nullptr, (dbName + ".db").c_str(), nullptr, DB_BTREE, dbFlags, 0);
+        } catch (const DbException& e) {
+            std::cerr << "Error opening database.\n";
+            std::cerr << e.what() << std::endl;
+            std::exit(DbErrorCode::DB_ERROR);
+        } catch (const std::exception& e) {
+            std::cerr << e.what() << std::endl;
+            std::exit(DbErrorCode::DB_ERROR);
+        }
+
+        if (options.recordHotKeys) {
+            mHotKeyLimit = std::max<size_t>(1, cachePages());
+        }
+
+        if (options.valueIndex) {
+            std::cout << "Opening value index...\n";
+            try {
+                mIndex = new Db(mEnv, 0); // Secondary database
+                mIndex->set_flags(DB_DUP | DB_DUPSORT); // Many keys may share a value
+                setGeometry(mIndex, options);
+                mIndex->open(nullptr, (dbName + "_value.db").c_str(), nullptr, DB_BTREE, dbFlags, 0);
+                // DB_CREATE only builds an empty index, and puts made while
+                // it was not associated are missing from it, so it is
+                // emptied and rebuilt from the records. Puts update it after.
+                u_int32_t stale = 0;
+                mIndex->truncate(nullptr, &stale, 0);
+                mDatabase->associate(nullptr, mIndex, indexValue, DB_CREATE);
+            } catch (const DbException& e) {
+                std::cerr << "Error opening value index.\n";
+                std::cerr << e.what() << std::endl;
+                std::exit(DbErrorCode::DB_ERROR);
+            } catch (const std::exception& e) {
+                std::cerr << e.what() << std::endl;
+                std::exit(DbErrorCode::DB_ERROR);
+            }
+        }
+
+        if (options.prefixSumCapacity > 0) {
+            std::cout << "Opening prefix-sum index...\n";
+            try {
+                mPrefix = new Db(mEnv, 0); // Fenwick tree database
+                setGeometry(mPrefix, options);
+                mPrefix->open(nullptr, (dbName + "_prefix.db").c_str(), nullptr, DB_BTREE, dbFlags, 0);
+                openPrefixIndex(options.prefixSumCapacity);
+            } catch (const DbException& e) {
+                std::cerr << "Error opening prefix-sum index.\n";
+                std::cerr << e.what() << std::endl;
+                std::exit(DbErrorCode::DB_ERROR);
+            } catch (const std::exception& e) {
+                std::cerr << e.what() << std::endl;
+                std::exit(DbErrorCode::DB_ERROR);
+            }
+        }
+    }
+
+    ~Database() {
+        flush(); // Write out buffered puts
+        if (mHotKeyLimit > 0) {
+            saveHotKeys();
+        }
+        std::cout << "Closing database...\n";
+        if (mStorage != nullptr) {
+            delete mStorage;
+            return;
+        }
+        if (mIndex != nullptr) {
+            mIndex->close(0); // Close secondaries before their primary
+            delete mIndex;
+        }
+        if (mPrefix != nullptr) {
+            savePrefixMeta(); // The tree matches the records again
+            mPrefix->close(0);
+            delete mPrefix;
+        }
+        mDatabase->close(0); // Close the database
+        mEnv->close(0); // Close the environment
+
+        delete mDatabase;
+        delete mEnv;
+    }
+
+    int get(int k); // Fetch the value
+    void put(int k, int v); // Store the value
+    // Move amount from record from to record to. With snapshot reads both
+    // change in one transaction, so no snapshot sees only one of them.
+    void transfer(int from, int to, int amount);
+    void multiGet(const int* keys, int* values, size_t n); // values[i] = get(keys[i]), in one B-tree pass
+    long long parallelSum(int n, int partitions); // Sum values of keys [0, n)
+    int scan(int start, int count); // Read up to count records from key start
+    void flush(); // Write buffered puts to the B-tree
+
+    // Read pages into the cache before serving: the key ranges saved by
+    // the last run with recordHotKeys if any (and hotKeys is set), else
+    // the database files front to back. Returns pages or ranges loaded.
+    size_t warmUp(bool hotKeys = true);
+    // Make the next open cold: remove the environment, which holds the
+    // cache, and drop the kernel's cached pages of the database files.
+    // No Database may be open.
+    static void dropCaches(const std::string& dbName);
+
+    // Page count, fill and tree depth of each database file, from Db::stat,
+    // or the storage engine's own report
+    void printPageReport();
+
+    // Value queries: log-time seeks on the value index when it is
+    // maintained, full scans of the database otherwise
+    long long countValues(int lo, int hi); // Records with value in [lo, hi]
+    long long sumValues(int lo, int hi); // Sum of values in [lo, hi]
+    std::vector<std::pair<int, int>> topValues(int k); // k largest values as <key, value>, descending
+
+    // Sum of values of keys in [lo, hi], O(log n) page reads with the
+    // prefix-sum index (keys outside its capacity are not counted)
+    long long sum(int lo, int hi);
+    int prefixCapacity(); // Keys covered by the prefix-sum index, 0 without it
+
+    void encodeKey(int k, char* data); // Write the KEY_SIZE key bytes stored in the B-tree
+    int decodeKey(const void* data);
+    static void encodeOrdered(int v, char* data); // Big-endian, sign bit flipped
+    static int decodeOrdered(const void* data);
+
+  private:
+    void requireBerkeleyDb(const char* operation); // Exit unless records are in Berkeley DB
+    int fetch(int k); // Read value from the B-tree
+    static void setGeometry(Db* db, const DatabaseOptions& options);
+    static void printPageReport(Db* db, const std::string& name);
+    size_t cachePages(); // Pages that fit in the cache
+    size_t preloadFile(Db* db, size_t maxPages);
+    std::string hotKeyPath();
+    void saveHotKeys();
+    void openPrefixIndex(int capacity);
+    void savePrefixMeta();
+    static unsigned long long prefixWeight(int k); // Checksum weight of key k
+    long long prefixNode(int i); // Fenwick tree node i (1-based)
+    void putPrefixNode(int i, long long sum);
+    long long prefixSum(int k); // Sum of values of keys [0, k]
+    void store(int k, int v); // Write value to the B-tree
+    void storeIndexed(int k, int v); // Write value to the B-tree and the prefix-sum index
+    void addToPrefix(int k, long long delta); // Add to the Fenwick nodes covering k
+    void flushBuffer();
+    long long scanSum(const std::string* first, const std::string* last, int n, DbTxn* snapshot);
+    DbTxn* beginSnapshot(); // Snapshot transaction, or nullptr without snapshot reads
+    template <typename F>
+    void forEachValue(int lo, int hi, F visit);
+    static int indexValue(Db* secondary, const Dbt* key, const Dbt* data, Dbt* result);
+};
+
+inline void Database::encodeKey(int k, char* data) {
+    if (mKeyEncoding == KeyEncoding::NATIVE) {
+        std::memcpy(data, &k, KEY_SIZE);
+        return;
+    }
+
+    encodeOrdered(k, data);
+}
+
+inline int Database::decodeKey(const void* data) {
+    if (mKeyEncoding == KeyEncoding::NATIVE) {
+        int k;
+        std::memcpy(&k, data, KEY_SIZE);
+        return k;
+    }
+
+    return decodeOrdered(data);
+}
+
+inline void Database::encodeOrdered(int v, char* data) {
+    // Flipping the sign bit puts negative values before positive ones
+    uint32_t u = static_cast<uint32_t>(v) ^ 0x80000000u;
+    data[0] = static_cast<char>(u >> 24);
+    data[1] = static_cast<char>(u >> 16);
+    data[2] = static_cast<char>(u >> 8);
+    data[3] = static_cast<char>(u);
+}
+
+inline int Database::decodeOrdered(const void* data) {
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    uint32_t u = (uint32_t(bytes[0]) << 24) | (uint32_t(bytes[1]) << 16) | (uint32_t(bytes[2]) << 8) | bytes[3];
+    return static_cast<int>(u ^ 0x80000000u);
+}
+
+// Secondary key callback: index each record by its value, ordered encoding
+inline int Database::indexValue(Db*, const Dbt*, const Dbt* data, Dbt* result) {
+    int v;
+    std::memcpy(&v, data->get_data(), sizeof(v));
+
+    char* indexKey = static_cast<char*>(std::malloc(KEY_SIZE));
+    encodeOrdered(v, indexKey);
+    result->set_data(indexKey);
+    result->set_size(KEY_SIZE);
+    result->set_flags(DB_DBT_APPMALLOC); // Berkeley DB frees it
+    return 0;
+}
+
+inline int Database::get(int k) {
+    if (mBufferCapacity > 0) {
+        std::lock_guard<std::mutex> guard(mBufferLock);
+        auto it = mBuffer.find(k);
+        if (it != mBuffer.end()) {
+            return it->second; // Buffered value is newer than the B-tree
+        }
+    }
+    return fetch(k);
+}
+
+inline void Database::put(int k, int v) {
+    if (mBufferCapacity == 0) {
+        if (mPrefix == nullptr) {
+            store(k, v);
+            return;
+        }
+        std::lock_guard<std::mutex> guard(mPrefixLock);
+        storeIndexed(k, v);
+        return;
+    }
+
+    std::lock_guard<std::mutex> guard(mBufferLock);
+    mBuffer[k] = v;
+    if (mBuffer.size() >= mBufferCapacity) {
+        flushBuffer();
+    }
+}
+
+// Keys are looked up in B-tree order with a single cursor, so a batch
+// visits each leaf page once however its keys are ordered
+inline void Database::multiGet(const int* keys, int* values, size_t n) {
+    if (mStorage != nullptr || n < 2) {
+        for (size_t i = 0; i < n; ++i) {
+            values[i] = get(keys[i]);
+        }
+        return;
+    }
+
+    std::vector<char> encoded(n * KEY_SIZE);
+    std::vector<size_t> order;
+    order.reserve(n);
+    for (size_t i = 0; i < n; ++i) {
+        if (mBufferCapacity > 0) {
+            std::lock_guard<std::mutex> guard(mBufferLock);
+            auto it = mBuffer.find(keys[i]);
+            if (it != mBuffer.end()) {
+                values[i] = it->second; // Buffered value is newer than the B-tree
+                continue;
+            }
+        }
+        encodeKey(keys[i], &encoded[i * KEY_SIZE]);
+        order.push_back(i);
+    }
+    std::sort(order.begin(), order.end(), [&encoded](size_t a, size_t b) {
+        return std::memcmp(&encoded[a * KEY_SIZE], &encoded[b * KEY_SIZE], KEY_SIZE) < 0;
+    });
+
+    Dbc* cursor;
+    this->mDatabase->cursor(nullptr, &cursor, 0);
+    int v;
+    Dbt value(&v, sizeof(v));
+    value.set_ulen(sizeof(v));
+    value.set_flags(DB_DBT_USERMEM);
+    for (size_t i : order) {
+        Dbt key(&encoded[i * KEY_SIZE], KEY_SIZE);
+        values[i] = cursor->get(&key, &value, DB_SET) == 0 ? v : 0;
+    }
+    cursor->close();
+}
+
+inline void Database::flush() {
+    std::lock_guard<std::mutex> guard(mBufferLock);
+    flushBuffer();
+}
+
+// Write the buffer in key order, so the B-tree sees sequential inserts.
+// Caller holds mBufferLock.
+inline void Database::flushBuffer() {
+    std::lock_guard<std::mutex> guard(mPrefixLock);
+    for (const auto& entry : mBuffer) {
+        storeIndexed(entry.first, entry.second);
+    }
+    mBuffer.clear();
+}
+
+inline int Database::fetch(int k) {
+    char keyData[KEY_SIZE];
+    encodeKey(k, keyData);
+    Dbt key(keyData, KEY_SIZE); // Create database key
+    int v = 0;
+    Dbt value(static_cast<void*>(&v), sizeof(v)); // Value, read into v (required with DB_THREAD)
+    value.set_ulen(sizeof(v));
+    value.set_flags(DB_DBT_USERMEM);
+    if (mStorage != nullptr) {
+        std::shared_lock<std::shared_mutex> guard(mStorageLock);
+        mStorage->get(keyData, KEY_SIZE, &v, sizeof(v));
+    } else {
+        this->mDatabase->get(nullptr, &key, &value, 0); // Get the value from database
+    }
+
+    if (mHotKeyLimit > 0) {
+        std::lock_guard<std::mutex> guard(mHotKeyLock);
+        if (mHotKeys.size() < mHotKeyLimit) {
+            mHotKeys.insert(k & ~(HOT_KEY_RANGE - 1)); // Start of k's range
+        }
+    }
+    return v; // Return the value
+}
+
+// Add the change of value to every Fenwick node covering k, then store
+// it. Caller holds mPrefixLock.
+inline void Database::storeIndexed(int k, int v) {
+    if (mPrefix != nullptr && k >= 0 && k < mPrefixCapacity) {
+        addToPrefix(k, static_cast<long long>(v) - fetch(k));
+    }
+    store(k, v);
+}
+
+// Caller holds mPrefixLock
+inline void Database::addToPrefix(int k, long long delta) {
+    if (mPrefix == nullptr || k < 0 || k >= mPrefixCapacity || delta == 0) {
+        return;
+    }
+    for (int i = k + 1; i <= mPrefixCapacity; i += i & -i) {
+        putPrefixNode(i, prefixNode(i) + delta);
+    }
+    mPrefixChecksum += static_cast<unsigned long long>(delta) * prefixWeight(k);
+}
+
+// Without snapshot reads the two records are simply put one after the
+// other. A transaction that loses a deadlock to another writer is retried.
+inline void Database::transfer(int from, int to, int amount) {
+    if (!mSnapshotReads) {
+        put(from, get(from) - amount);
+        put(to, get(to) + amount);
+        return;
+    }
+
+    flush(); // Buffered values of these keys would overwrite the transfer
+    std::lock_guard<std::mutex> prefixGuard(mPrefixLock);
+    std::shared_lock<std::shared_mutex> guard(mSnapshotLock);
+    const int keys[2] = {from, to};
+    const int deltas[2] = {-amount, amount};
+    for (;;) {
+        DbTxn* txn = nullptr;
+        try {
+            mEnv->txn_begin(nullptr, &txn, 0);
+            bool deadlocked = false; // Deadlocks are thrown, or returned by handles without exceptions
+            for (int i = 0; i < 2 && !deadlocked; ++i) {
+                char keyData[KEY_SIZE];
+                encodeKey(keys[i], keyData);
+                Dbt key(keyData, KEY_SIZE);
+                int v = 0;
+                Dbt value(&v, sizeof(v));
+                value.set_ulen(sizeof(v));
+                value.set_flags(DB_DBT_USERMEM);
+                deadlocked = this->mDatabase->get(txn, &key, &value, DB_RMW) == DB_LOCK_DEADLOCK; // Locked to commit
+                if (!deadlocked) {
+                    v += deltas[i];
+                    Dbt newValue(&v, sizeof(v));
+                    deadlocked = this->mDatabase->put(txn, &key, &newValue, 0) == DB_LOCK_DEADLOCK;
+                }
+            }
+            if (!deadlocked) {
+                txn->commit(0);
+                break;
+            }
+            txn->abort();
+        } catch (const DbDeadlockException&) {
+            txn->abort();
+        } catch (const DbException& e) {
+            std::cerr << "Error transferring between " << from << " and " << to << ".\n";
+            std::cerr << e.what() << std::endl;
+            std::exit(DbErrorCode::DB_ERROR);
+        }
+    }
+
+    addToPrefix(from, -amount);
+    addToPrefix(to, amount);
+}
+
+inline void Database::store(int k, int v) {
+    char keyData[KEY_SIZE];
+    encodeKey(k, keyData);
+    Dbt key(keyData, KEY_SIZE); // Create database key
+    Dbt value(static_cast<void*>(&v), sizeof(v)); // Create database value
+    if (mStorage != nullptr) {
+        std::unique_lock<std::shared_mutex> guard(mStorageLock);
+        mStorage->put(keyData, KEY_SIZE, &v, sizeof(v));
+        return;
+    }
+    if (mSnapshotReads) {
+        std::shared_lock<std::shared_mutex> guard(mSnapshotLock);
+        // Commits before the lock is released. A put that loses a deadlock
+        // to another writer is rolled back, so it is simply retried.
+        for (;;) {
+            try {
+                if (this->mDatabase->put(nullptr, &key, &value, 0) != DB_LOCK_DEADLOCK) {
+                    return;
+                }
+            } catch (const DbDeadlockException&) {
+            }
+        }
+    }
+    this->mDatabase->put(nullptr, &key, &value, 0); // // Store value in database
+}
+
+inline void Database::requireBerkeleyDb(const char* operation) {
+    if (mStorage != nullptr) {
+        std::cerr << "Error: " << operation << " needs the Berkeley DB storage engine.\n";
+        std::exit(DbErrorCode::DB_ERROR);
+    }
+}
+
+inline void Database::setGeometry(Db* db, const DatabaseOptions& options) {
+    if (options.pageSize > 0) {
+        db->set_pagesize(options.pageSize);
+    }
+    if (options.btreeMinKey > 0) {
+        db->set_bt_minkey(options.btreeMinKey); // Larger values push bigger records to overflow pages
+    }
+}
+
+inline void Database::printPageReport() {
+    if (mStorage != nullptr) {
+        mStorage->printReport();
+        return;
+    }
+    printPageReport(mDatabase, mName);
+    if (mIndex != nullptr) {
+        printPageReport(mIndex, mName + "_value");
+    }
+    if (mPrefix != nullptr) {
+        printPageReport(mPrefix, mName + "_prefix");
+    }
+}
+
+// The full stat reads every page, so this is for after a load, not for
+// the hot path
+inline void Database::printPageReport(Db* db, const std::string& name) {
+    DB_BTREE_STAT* stat;
+    db->stat(nullptr, &stat, 0);
+
+    uintmax_t pages = uintmax_t(stat->bt_int_pg) + stat->bt_leaf_pg + stat->bt_dup_pg + stat->bt_over_pg;
+    uintmax_t freeBytes = stat->bt_int_pgfree + stat->bt_leaf_pgfree + stat->bt_dup_pgfree + stat->bt_over_pgfree;
+    double fill = pages > 0 ? 100.0 * (pages * stat->bt_pagesize - freeBytes) / (pages * stat->bt_pagesize) : 0;
+    std::cout << "Pages of " << name << ": " << stat->bt_pagecnt << " x " << stat->bt_pagesize << " bytes, "
+              << stat->bt_levels << " levels, " << stat->bt_int_pg << " internal, " << stat->bt_leaf_pg << " leaf, "
+              << stat->bt_dup_pg << " duplicate, " << stat->bt_over_pg << " overflow, minkey " << stat->bt_minkey
+              << ", " << stat->bt_ndata << " records, " << fill << "% full" << std::endl;
+
+    std::free(stat); // Allocated by Berkeley DB
+}
+
+inline size_t Database::cachePages() {
+    u_int32_t gbytes, bytes, pageSize;
+    int caches;
+    mEnv->get_cachesize(&gbytes, &bytes, &caches);
+    mDatabase->get_pagesize(&pageSize);
+    return ((static_cast<size_t>(gbytes) << 30) + bytes) / pageSize;
+}
+
+inline std::string Database::hotKeyPath() {
+    return "./db/" + mName + ".hot";
+}
+
+// Ranges are saved in key order, so that warmUp() reads them in one pass
+inline void Database::saveHotKeys() {
+    std::vector<int> ranges(mHotKeys.begin(), mHotKeys.end());
+    std::sort(ranges.begin(), ranges.end());
+
+    std::ofstream out(hotKeyPath(), std::ios::binary | std::ios::trunc);
+    out.write(reinterpret_cast<const char*>(ranges.data()), ranges.size() * sizeof(int));
+    if (!out) {
+        std::cerr << "Error: Unable to save hot keys to " << hotKeyPath() << ".\n";
+    }
+}
+
+// Read the first maxPages pages of db's file through the cache
+inline size_t Database::preloadFile(Db* db, size_t maxPages) {
+    DbMpoolFile* file = db->get_mpf();
+    db_pgno_t last = 0;
+    file->get_last_pgno(&last);
+
+    size_t pages = std::min(static_cast<size_t>(last) + 1, maxPages);
+    for (size_t i = 0; i < pages; ++i) {
+        db_pgno_t pgno = i;
+        void* page;
+        if (file->get(&pgno, nullptr, 0, &page) == 0) {
+            file->put(page, DB_PRIORITY_UNCHANGED, 0); // Only needed it loaded
+        }
+    }
+    return pages;
+}
+
+inline size_t Database::warmUp(bool hotKeys) {
+    requireBerkeleyDb("Warm-up");
+
+    std::vector<int> ranges;
+    std::ifstream in(hotKeyPath(), std::ios::binary);
+    for (int k; hotKeys && in.read(reinterpret_cast<char*>(&k), sizeof(k));) {
+        ranges.push_back(k);
+    }
+
+    if (!ranges.empty()) {
+        // Positioning a cursor in each range reads its root-to-leaf path
+        Dbc* cursor;
+        this->mDatabase->cursor(nullptr, &cursor, 0);
+
+        char keyData[KEY_SIZE];
+        Dbt key(keyData, sizeof(keyData));
+        key.set_ulen(sizeof(keyData));
+        key.set_flags(DB_DBT_USERMEM);
+
+        int v;
+        Dbt value(&v, sizeof(v));
+        value.set_ulen(sizeof(v));
+        value.set_flags(DB_DBT_USERMEM);
+
+        for (int k : ranges) {
+            encodeKey(k, keyData);
+            cursor->get(&key, &value, DB_SET_RANGE);
+        }
+
+        cursor->close();
+        return ranges.size();
+    }
+
+    // Without a recorded list, fill the cache in file order
+    size_t budget = cachePages();
+    size_t loaded = 0;
+    for (Db* db : {mDatabase, mIndex, mPrefix}) {
+        if (db != nullptr && loaded < budget) {
+            loaded += preloadFile(db, budget - loaded);
+        }
+    }
+    return loaded;
+}
+
+inline void Database::dropCaches(const std::string& dbName) {
+    try {
+        DbEnv env(0);
+        env.remove("./db", 0); // Fails while the environment is in use
+    } catch (const DbException& e) {
+        std::cerr << "Error: Unable to remove environment.\n";
+        std::cerr << e.what() << std::endl;
+    }
+
+    for (const std::string& file : {dbName + ".db", dbName + "_value.db", dbName + "_prefix.db"}) {
+        int fd = ::open(("./db/" + file).c_str(), O_RDONLY);
+        if (fd >= 0) {
+            posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED); // Pages are clean after close
+            ::close(fd);
+        }
+    }
+}
+
+// Sum values of keys in [0, n) stored in B-tree order between first and
+// last (nullptr = start/end of tree), using a cursor of its own, in
+// snapshot unless it is nullptr.
+inline long long Database::scanSum(const std::string* first, const std::string* last, int n, DbTxn* snapshot) {
+    Dbc* cursor;
+    this->mDatabase->cursor(snapshot, &cursor, 0);
+
+    char keyData[KEY_SIZE];
+    Dbt key(keyData, sizeof(keyData));
+    key.set_ulen(sizeof(keyData));
+    key.set_flags(DB_DBT_USERMEM);
+
+    int v;
+    Dbt value(&v, sizeof(v));
+    value.set_ulen(sizeof(v));
+    value.set_flags(DB_DBT_USERMEM);
+
+    int flags = DB_FIRST;
+    if (first != nullptr) {
+        std::memcpy(keyData, first->data(), KEY_SIZE);
+        flags = DB_SET_RANGE; // Position at first key >= first
+    }
+
+    long long sum = 0;
+    for (int ret = cursor->get(&key, &value, flags); ret == 0; ret = cursor->get(&key, &value, DB_NEXT)) {
+        if (last != nullptr && std::memcmp(keyData, last->data(), KEY_SIZE) >= 0) {
+            break; // Reached next partition
+        }
+
+        int k = decodeKey(keyData);
+        if (k >= 0 && k < n) {
+            sum += v;
+        }
+    }
+
+    cursor->close();
+    return sum;
+}
+
+// Read up to count records in B-tree order, starting at the first key
+// >= start. Returns the number of records read.
+inline int Database::scan(int start, int count) {
+    requireBerkeleyDb("Scan");
+    flush(); // Cursor only sees the B-tree
+
+    DbTxn* snapshot = beginSnapshot(); // Records read are from one state
+    Dbc* cursor;
+    this->mDatabase->cursor(snapshot, &cursor, 0);
+
+    char keyData[KEY_SIZE];
+    encodeKey(start, keyData);
+    Dbt key(keyData, sizeof(keyData));
+    key.set_ulen(sizeof(keyData));
+    key.set_flags(DB_DBT_USERMEM);
+
+    int v;
+    Dbt value(&v, sizeof(v));
+    value.set_ulen(sizeof(v));
+    value.set_flags(DB_DBT_USERMEM);
+
+    int read = 0;
+    for (int ret = cursor->get(&key, &value, DB_SET_RANGE); ret == 0 && read < count;
+         ret = cursor->get(&key, &value, DB_NEXT)) {
+        ++read;
+    }
+
+    cursor->close(); // Before its transaction ends
+    if (snapshot != nullptr) {
+        snapshot->commit(0);
+    }
+    return read;
+}
+
+inline long long Database::parallelSum(int n, int partitions) {
+    flush(); // Cursors only see the B-tree
+
+    if (mStorage != nullptr) {
+        // No cursors: each thread reads an equal slice of keys one by one
+        std::vector<long long> sums(partitions, 0);
+        std::vector<std::thread> workers;
+        for (int p = 0; p < partitions; ++p) {
+            workers.emplace_back([this, &sums, p, partitions, n]() {
+                int first = static_cast<long long>(p) * n / partitions;
+                int last = static_cast<long long>(p + 1) * n / partitions;
+                for (int k = first; k < last; ++k) {
+                    sums[p] += fetch(k);
+                }
+            });
+        }
+
+        long long sum = 0;
+        for (int p = 0; p < partitions; ++p) {
+            workers[p].join();
+            sum += sums[p];
+        }
+        return sum;
+    }
+
+    // Partition boundaries are the keys i * n / partitions, ordered as the
+    // B-tree orders them, so the slices are disjoint and cover every key.
+    // With ordered keys they are equal numeric ranges.
+    std::vector<std::string> bounds;
+    for (int p = 1; p < partitions; ++p) {
+        char keyData[KEY_SIZE];
+        encodeKey(static_cast<long long>(p) * n / partitions, keyData);
+        bounds.emplace_back(keyData, KEY_SIZE);
+    }
+    std::sort(bounds.begin(), bounds.end());
+
+    // A transaction is used by one thread at a time, so each partition
+    // gets its own snapshot. They are begun while no put is in progress
+    // and so all read the same committed state.
+    std::vector<DbTxn*> snapshots(partitions, nullptr);
+    if (mSnapshotReads) {
+        std::unique_lock<std::shared_mutex> guard(mSnapshotLock);
+        for (DbTxn*& snapshot : snapshots) {
+            snapshot = beginSnapshot();
+        }
+    }
+
+    std::vector<long long> sums(partitions, 0);
+    std::vector<std::thread> workers;
+    for (int p = 0; p < partitions; ++p) {
+        workers.emplace_back([this, &bounds, &sums, &snapshots, p, partitions, n]() {
+            const std::string* first = p > 0 ? &bounds[p - 1] : nullptr;
+            const std::string* last = p < partitions - 1 ? &bounds[p] : nullptr;
+            try {
+                sums[p] = scanSum(first, last, n, snapshots[p]);
+            } catch (const DbException& e) {
+                std::cerr << "Error scanning partition " << p << ".\n";
+                std::cerr << e.what() << std::endl;
+                std::exit(DbErrorCode::DB_ERROR);
+            }
+        });
+    }
+
+    long long sum = 0;
+    for (int p = 0; p < partitions; ++p) {
+        workers[p].join();
+        sum += sums[p]; // Merge partial sums
+        if (snapshots[p] != nullptr) {
+            snapshots[p]->commit(0); // Read-only, releases the snapshot
+        }
+    }
+
+    return sum;
+}
+
+inline DbTxn* Database::beginSnapshot() {
+    if (!mSnapshotReads) {
+        return nullptr;
+    }
+
+    DbTxn* snapshot = nullptr;
+    try {
+        mEnv->txn_begin(nullptr, &snapshot, DB_TXN_SNAPSHOT);
+    } catch (const DbException& e) {
+        std::cerr << "Error beginning snapshot.\n";
+        std::cerr << e.what() << std::endl;
+        std::exit(DbErrorCode::DB_ERROR);
+    }
+    return snapshot;
+}
+
+// Fenwick tree nodes are stored under their 1-based index, ordered
+// encoding, so that nodes touched by one query share leaf pages.
+inline long long Database::prefixNode(int i) {
+    char keyData[KEY_SIZE];
+    encodeOrdered(i, keyData);
+    Dbt key(keyData, KEY_SIZE);
+
+    long long sum = 0;
+    Dbt value(&sum, sizeof(sum));
+    value.set_ulen(sizeof(sum));
+    value.set_flags(DB_DBT_USERMEM);
+    mPrefix->get(nullptr, &key, &value, 0);
+    return sum;
+}
+
+inline void Database::putPrefixNode(int i, long long sum) {
+    char keyData[KEY_SIZE];
+    encodeOrdered(i, keyData);
+    Dbt key(keyData, KEY_SIZE);
+    Dbt value(&sum, sizeof(sum));
+    mPrefix->put(nullptr, &key, &value, 0);
+}
+
+// Mixes the key so that moving value between keys changes the checksum
+inline unsigned long long Database::prefixWeight(int k) {
+    unsigned long long x = static_cast<unsigned int>(k) + 0x9E3779B97F4A7C15ULL;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+    return x ^ (x >> 31);
+}
+
+// Scan the records into a tree in memory. The stored tree is kept when
+// its capacity and checksum match; otherwise it is new, was built for
+// another capacity or missed puts made without the index, and is rebuilt.
+inline void Database::openPrefixIndex(int capacity) {
+    // Linear-time construction: place each value at its node, then push
+    // every node's total into its parent
+    std::vector<long long> tree(capacity + 1, 0);
+    unsigned long long checksum = 0;
+    char keyData[KEY_SIZE];
+    Dbt key(keyData, sizeof(keyData));
+    key.set_ulen(sizeof(keyData));
+    key.set_flags(DB_DBT_USERMEM);
+
+    int v;
+    Dbt value(&v, sizeof(v));
+    value.set_ulen(sizeof(v));
+    value.set_flags(DB_DBT_USERMEM);
+
+    Dbc* cursor;
+    mDatabase->cursor(nullptr, &cursor, 0);
+    for (int ret = cursor->get(&key, &value, DB_FIRST); ret == 0; ret = cursor->get(&key, &value, DB_NEXT)) {
+        int k = decodeKey(keyData);
+        if (k >= 0 && k < capacity) {
+            tree[k + 1] += v;
+            checksum += static_cast<unsigned long long>(static_cast<long long>(v)) * prefixWeight(k);
+        }
+    }
+    cursor->close();
+
+    mPrefixCapacity = capacity;
+    mPrefixChecksum = checksum;
+
+    Dbt metaKey(const_cast<char*>(PREFIX_META_KEY.data()), PREFIX_META_KEY.size());
+    PrefixMeta stored = {};
+    Dbt metaValue(&stored, sizeof(stored));
+    metaValue.set_ulen(sizeof(stored));
+    metaValue.set_flags(DB_DBT_USERMEM);
+    try {
+        if (mPrefix->get(nullptr, &metaKey, &metaValue, 0) == 0 && metaValue.get_size() == sizeof(stored) &&
+            stored.capacity == capacity && stored.checksum == checksum) {
+            return; // Up to date
+        }
+    } catch (const DbMemoryException&) {
+        // Not a meta record of this layout
+    }
+
+    std::cout << "Rebuilding prefix-sum index...\n";
+    u_int32_t stale = 0;
+    mPrefix->truncate(nullptr, &stale, 0); // Nodes past a smaller capacity would linger
+    for (int i = 1; i <= capacity; ++i) {
+        int parent = i + (i & -i);
+        if (parent <= capacity) {
+            tree[parent] += tree[i];
+        }
+        putPrefixNode(i, tree[i]);
+    }
+    savePrefixMeta();
+}
+
+inline void Database::savePrefixMeta() {
+    Dbt metaKey(const_cast<char*>(PREFIX_META_KEY.data()), PREFIX_META_KEY.size());
+    PrefixMeta meta = {mPrefixCapacity, mPrefixChecksum};
+    Dbt metaValue(&meta, sizeof(meta));
+    mPrefix->put(nullptr, &metaKey, &metaValue, 0);
+}
+
+inline long long Database::prefixSum(int k) {
+    long long sum = 0;
+    for (int i = std::min(k + 1, mPrefixCapacity); i > 0; i -= i & -i) {
+        sum += prefixNode(i);
+    }
+    return sum;
+}
+
+inline int Database::prefixCapacity() {
+    return mPrefix != nullptr ? mPrefixCapacity : 0;
+}
+
+inline long long Database::sum(int lo, int hi) {
+    if (mPrefix == nullptr) {
+        // No index: scan the keys one by one
+        long long sum = 0;
+        for (int k = lo; k <= hi; ++k) {
+            sum += get(k);
+        }
+        return sum;
+    }
+
+    lo = std::max(lo, 0);
+    hi = std::min(hi, mPrefixCapacity - 1);
+    if (lo > hi) {
+        return 0;
+    }
+    flush(); // The index only covers stored records
+    std::lock_guard<std::mutex> guard(mPrefixLock);
+    return prefixSum(hi) - prefixSum(lo - 1);
+}
+
+// Call visit(value) for every record with value in [lo, hi]
+template <typename F>
+void Database::forEachValue(int lo, int hi, F visit) {
+    requireBerkeleyDb("Value queries");
+    flush(); // Cursors only see the B-tree
+
+    char keyData[KEY_SIZE];
+    Dbt key(keyData, sizeof(keyData));
+    key.set_ulen(sizeof(keyData));
+    key.set_flags(DB_DBT_USERMEM);
+
+    int v;
+    Dbt value(&v, sizeof(v));
+    value.set_ulen(sizeof(v));
+    value.set_flags(DB_DBT_USERMEM);
+
+    Dbc* cursor;
+    if (mIndex != nullptr) {
+        // Seek to the first index entry >= lo and stop past hi
+        mIndex->cursor(nullptr, &cursor, 0);
+        encodeOrdered(lo, keyData);
+        for (int ret = cursor->get(&key, &value, DB_SET_RANGE); ret == 0 && decodeOrdered(keyData) <= hi;
+             ret = cursor->get(&key, &value, DB_NEXT)) {
+            visit(v);
+        }
+    } else {
+        mDatabase->cursor(nullptr, &cursor, 0);
+        for (int ret = cursor->get(&key, &value, DB_FIRST); ret == 0; ret = cursor->get(&key, &value, DB_NEXT)) {
+            if (v >= lo && v <= hi) {
+                visit(v);
+            }
+        }
+    }
+
+    cursor->close();
+}
+
+inline long long Database::countValues(int lo, int hi) {
+    long long count = 0;
+    forEachValue(lo, hi, [&count](int) { ++count; });
+    return count;
+}
+
+inline long long Database::sumValues(int lo, int hi) {
+    long long sum = 0;
+    forEachValue(lo, hi, [&sum](int v) { sum += v; });
+    return sum;
+}
+
+inline std::vector<std::pair<int, int>> Database::topValues(int k) {
+    requireBerkeleyDb("Value queries");
+    flush(); // Cursors only see the B-tree
+
+    std::vector<std::pair<int, int>> top;
+    if (k <= 0) {
+        return top;
+    }
+
+    char keyData[KEY_SIZE];
+    Dbt key(keyData, sizeof(keyData));
+    key.set_ulen(sizeof(keyData));
+    key.set_flags(DB_DBT_USERMEM);
+
+    int v;
+    Dbt value(&v, sizeof(v));
+    value.set_ulen(sizeof(v));
+    value.set_flags(DB_DBT_USERMEM);
+
+    Dbc* cursor;
+    if (mIndex != nullptr) {
+        // Walk the index backwards from the largest value
+        char primaryKeyData[KEY_SIZE];
+        Dbt primaryKey(primaryKeyData, sizeof(primaryKeyData));
+        primaryKey.set_ulen(sizeof(primaryKeyData));
+        primaryKey.set_flags(DB_DBT_USERMEM);
+
+        mIndex->cursor(nullptr, &cursor, 0);
+        for (int ret = cursor->pget(&key, &primaryKey, &value, DB_LAST); ret == 0 && (int)top.size() < k;
+             ret = cursor->pget(&key, &primaryKey, &value, DB_PREV)) {
+            top.push_back({decodeKey(primaryKeyData), v});
+        }
+    } else {
+        // Keep the k largest seen so far in a min-heap on value
+        auto greaterValue = [](const std::pair<int, int>& a, const std::pair<int, int>& b) {
+            return a.second > b.second;
+        };
+        std::priority_queue<std::pair<int, int>, std::vector<std::pair<int, int>>, decltype(greaterValue)> heap(
+            greaterValue);
+
+        mDatabase->cursor(nullptr, &cursor, 0);
+        for (int ret = cursor->get(&key, &value, DB_FIRST); ret == 0; ret = cursor->get(&key, &value, DB_NEXT)) {
+            if ((int)heap.size() < k) {
+                heap.push({decodeKey(keyData), v});
+            } else if (v > heap.top().second) {
+                heap.pop();
+                heap.push({decodeKey(keyData), v});
+            }
+        }
+
+        for (; !heap.empty(); heap.pop()) {
+            top.push_back(heap.top());
+        }
+        std::reverse(top.begin(), top.end());
+    }
+
+    cursor->close();
+    return top;
+}
+
+#endif // DATABASE_H
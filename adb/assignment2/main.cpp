@@ -1,80 +1,16 @@
+#include <algorithm>
+#include <atomic>
 #include <cmath>
 #include <ctime>
-#include <db_cxx.h> // Berkeley DB
 #include <exception>
 #include <iostream>
 #include <random>
 #include <string>
 #include <sys/time.h> // gettimeofday
+#include <thread>
+#include <vector>
 
-enum DbErrorCode {
-    DB_SUCCESS,
-    DB_ERROR
-};
-
-class Database {
-  private:
-    DbEnv* mEnv; // Berkeley DB environment variable
-    Db* mDatabase; // Berkeley DB connection
-
-  public:
-    Database(const std::string dbName) : mEnv(nullptr), mDatabase(nullptr) {
-        mEnv = new DbEnv(0); // Berkeley DB Environment
-        mEnv->set_error_stream(&std::cerr); // Set error stream
-        mEnv->set_cachesize(0, 64 * 1024, 0); // Allocate cache memory
-
-        try {
-            mEnv->open("./db", DB_CREATE | DB_INIT_MPOOL, 0); // Open environment
-        } catch (const DbException& e) {
-            std::cerr << "Error: Unable to open db.\n";
-            std::cerr << e.what() << std::endl;
-            std::exit(DbErrorCode::DB_ERROR);
-        } catch (const std::exception& e) {
-            std::cerr << "Error: Unable to create environment.\n";
-            std::cerr << e.what() << std::endl;
-            std::exit(DbErrorCode::DB_ERROR);
-        }
-
-        std::cout << "Opening database...\n";
-        try {
-            mDatabase = new Db(mEnv, 0); // Database
-            // Open the database
-            mDatabase->open(nullptr, (dbName + ".db").c_str(), nullptr, DB_BTREE, DB_CREATE, 0);
-        } catch (const DbException& e) {
-            std::cerr << "Error opening database.\n";
-            std::cerr << e.what() << std::endl;
-            std::exit(DbErrorCode::DB_ERROR);
-        } catch (const std::exception& e) {
-            std::cerr << e.what() << std::endl;
-            std::exit(DbErrorCode::DB_ERROR);
-        }
-    }
-
-    ~Database() {
-        std::cout << "Closing database...\n";
-        mDatabase->close(0); // Close the database
-        mEnv->close(0); // Close the environment
-
-        delete mDatabase;
-        delete mEnv;
-    }
-
-    int get(int k); // Fetch the value
-    void put(int k, int v); // Store the value
-};
-
-inline int Database::get(int k) {
-    Dbt key(static_cast<void*>(&k), sizeof(k)); // Create database key
-    Dbt value; // Value
-    this->mDatabase->get(nullptr, &key, &value, 0); // Get the value from database
-    return *static_cast<int*>(value.get_data()); // Return the value
-}
-
-inline void Database::put(int k, int v) {
-    Dbt key(static_cast<void*>(&k), sizeof(k)); // Create database key
-    Dbt value(static_cast<void*>(&v), sizeof(v)); // Create database value
-    this->mDatabase->put(nullptr, &key, &value, 0); // // Store value in database
-}
+#include "database.h"
 
 void printElapsedTime(const timeval& t1, const timeval& t2) {
     if (t1.tv_sec == t2.tv_sec) {
@@ -86,11 +22,11 @@ void printElapsedTime(const timeval& t1, const timeval& t2) {
 }
 
 // Store n random number in database
-void store(const std::string& db_name, const int n) {
+void store(const std::string& db_name, const int n, const DatabaseOptions& options) {
     timeval start; // Start time
     gettimeofday(&start, nullptr);
 
-    Database* database = new Database(db_name); // Open database
+    Database* database = new Database(db_name, options); // Open database
     std::srand(std::time(nullptr));
 
     std::cout << "Storing " << n << " random number..." << std::endl;
@@ -99,6 +35,8 @@ void store(const std::string& db_name, const int n) {
         database->put(i, r);
     }
     std::cout << "Done..." << std::endl;
+    database->flush(); // Report on the B-tree as loaded
+    database->printPageReport();
 
     delete database; // Close database
 
@@ -111,20 +49,116 @@ void store(const std::string& db_name, const int n) {
     std::cout << ".\n";
 }
 
-// Get sum of all the records stored in the database
-void printSum(const std::string& db_name, const int n) {
+// Get sum of all the records stored in the database, scanning with
+// threads cursors in parallel when threads > 1. With snapshot reads the
+// sum is read from a snapshot while a writer thread keeps moving value
+// between records, each move in one transaction, so the total never
+// changes. The snapshot sum matches the total after the writes; a sum read
+// key by key alongside it, without a snapshot, drifts.
+void printSum(const std::string& db_name, const int n, const int threads, const DatabaseOptions& options) {
     timeval start; // Start time
     gettimeofday(&start, nullptr);
 
-    Database* database = new Database(db_name); // Open database
+    Database* database = new Database(db_name, options); // Open database
+
+    std::atomic<bool> summing(true);
+    long long writes = 0;
+    std::thread writer;
+    if (options.snapshotReads && n > 0) {
+        writer = std::thread([database, n, &summing, &writes]() {
+            std::mt19937 random(std::random_device{}());
+            while (summing) {
+                database->transfer(random() % n, random() % n, random() % 100);
+                ++writes;
+            }
+        });
+    }
 
     long long int sum = 0;
+    long long int unsnapshotSum = 0;
     std::cout << "Computing sum of values stored in database..." << std::endl;
-    for (int i = 0; i < n; ++i) {
-        sum += database->get(i);
+    if (threads > 1 || options.snapshotReads) {
+        sum = database->parallelSum(n, threads);
+    } else {
+        for (int i = 0; i < n; ++i) {
+            sum += database->get(i);
+        }
+    }
+    if (writer.joinable()) {
+        for (int i = 0; i < n; ++i) {
+            unsnapshotSum += database->get(i); // Sees some moves half done
+        }
+        summing = false;
+        writer.join();
+        std::cout << "Transfers during sum = " << writes << std::endl;
     }
     std::cout << "Done..." << std::endl;
     std::cout << "Sum = " << sum << std::endl;
+    if (options.snapshotReads && n > 0) {
+        std::cout << "Sum without a snapshot = " << unsnapshotSum << std::endl;
+        std::cout << "Sum after transfers = " << database->parallelSum(n, threads) << std::endl;
+    }
+
+    delete database; // Close database
+
+    timeval elapsed; // Elapsed time
+    gettimeofday(&elapsed, nullptr);
+
+    // Total elapsed time
+    std::cout << "Time taken: ";
+    printElapsedTime(start, elapsed); // Print elapsed
+    std::cout << ".\n";
+}
+
+// Range and top-k queries over the stored values
+void printValueQueries(const std::string& db_name, const DatabaseOptions& options) {
+    timeval start; // Start time
+    gettimeofday(&start, nullptr);
+
+    Database* database = new Database(db_name, options); // Open database
+
+    const int lo = INT32_MAX / 4;
+    const int hi = INT32_MAX / 2;
+    std::cout << "Querying values in [" << lo << ", " << hi << "]..." << std::endl;
+    std::cout << "Count = " << database->countValues(lo, hi) << std::endl;
+    std::cout << "Sum = " << database->sumValues(lo, hi) << std::endl;
+    std::cout << "Top 5 (key: value):";
+    for (const std::pair<int, int>& record : database->topValues(5)) {
+        std::cout << ' ' << record.first << ": " << record.second;
+    }
+    std::cout << std::endl;
+
+    delete database; // Close database
+
+    timeval elapsed; // Elapsed time
+    gettimeofday(&elapsed, nullptr);
+
+    // Total elapsed time
+    std::cout << "Time taken: ";
+    printElapsedTime(start, elapsed); // Print elapsed
+    std::cout << ".\n";
+}
+
+// Windowed sums over key ranges, answered by the prefix-sum index
+void printWindowSums(const std::string& db_name, const int n, const DatabaseOptions& options) {
+    timeval start; // Start time
+    gettimeofday(&start, nullptr);
+
+    Database* database = new Database(db_name, options); // Open database
+    if (database->prefixCapacity() < n) {
+        std::cerr << "Error: prefix-sum index covers " << database->prefixCapacity() << " keys, not " << n << ".\n";
+        delete database;
+        std::exit(1);
+    }
+
+    const int windows = 4;
+    std::cout << "Computing sums of " << windows << " key windows..." << std::endl;
+    for (int w = 0; w < windows; ++w) {
+        int lo = static_cast<long long>(w) * n / windows;
+        int hi = static_cast<long long>(w + 1) * n / windows - 1;
+        std::cout << "Sum [" << lo << ", " << hi << "] = " << database->sum(lo, hi) << std::endl;
+    }
+    std::cout << "Sum [0, " << n - 1 << "] = " << database->sum(0, n - 1) << std::endl;
 
     delete database; // Close database
 
@@ -138,25 +172,80 @@ void printSum(const std::string& db_name, const int n) {
 }
 
 int main(const int argc, const char* argv[]) {
-    if (argc < 3) {
+    // Options may appear anywhere, the remaining arguments are positional
+    std::vector<std::string> args;
+    int threads = 1;
+    DatabaseOptions options;
+    try {
+        for (int i = 0; i < argc; ++i) {
+            if (std::string(argv[i]) == "--native-keys") {
+                options.keyEncoding = KeyEncoding::NATIVE;
+            } else if (std::string(argv[i]) == "--value-index") {
+                options.valueIndex = true;
+            } else if (std::string(argv[i]) == "--snapshot") {
+                options.snapshotReads = true;
+            } else if (std::string(argv[i]) == "--prefix-sum") {
+                options.prefixSumCapacity = -1; // Cover keys [0, n), set below
+            } else if (std::string(argv[i]) == "--threads" && i + 1 < argc) {
+                threads = std::max(1, std::stoi(argv[++i]));
+            } else if (std::string(argv[i]) == "--buffer" && i + 1 < argc) {
+                options.bufferCapacity = std::max(0, std::stoi(argv[++i]));
+            } else if (std::string(argv[i]) == "--page-size" && i + 1 < argc) {
+                options.pageSize = std::stoul(argv[++i]);
+            } else if (std::string(argv[i]) == "--minkey" && i + 1 < argc) {
+                options.btreeMinKey = std::stoul(argv[++i]);
+            } else if (std::string(argv[i]) == "--storage" && i + 1 < argc) {
+                if (!parseStorageEngine(argv[++i], options.engine)) {
+                    throw std::invalid_argument(argv[i]);
+                }
+            } else {
+                args.push_back(argv[i]);
+            }
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Error: Invalid option." << std::endl;
+        exit(1);
+    }
+
+    if (args.size() < 3) {
         std::cerr << "Usage: " << argv[0] << " database_name number" << std::endl;
+        std::cerr << "Options: --threads k  Compute sum with k parallel cursors" << std::endl;
+        std::cerr << "         --buffer n   Buffer up to n puts and write them in key order" << std::endl;
+        std::cerr << "         --native-keys  Store keys as raw host-order ints (database must match)" << std::endl;
+        std::cerr << "         --value-index  Maintain a value index and run range/top-k queries" << std::endl;
+        std::cerr << "         --prefix-sum   Maintain a prefix-sum index and run windowed sums" << std::endl;
+        std::cerr << "         --snapshot     Sum from a snapshot while a writer moves value between records" << std::endl;
+        std::cerr << "         --page-size b  Page size of a new database, in bytes" << std::endl;
+        std::cerr << "         --minkey k     Minimum keys per B-tree page of a new database" << std::endl;
+        std::cerr << "         --storage e    Storage engine: bdb (default), memory or mmap" << std::endl;
         std::exit(1);
     }
 
     int n;
     try { // Try casting to int
-        n = std::stoi(argv[2]);
+        n = std::stoi(args[2]);
     } catch (const std::exception& e) {
         std::cerr << "Error: Invalid number." << std::endl;
         exit(1);
     }
+    if (options.prefixSumCapacity != 0) {
+        options.prefixSumCapacity = n;
+    }
 
     timeval start; // Start time
     gettimeofday(&start, nullptr);
 
-    store(argv[1], n);
+    store(args[1], n, options);
     std::cout << std::endl;
-    printSum(argv[1], n);
+    printSum(args[1], n, threads, options);
+    if (options.valueIndex) {
+        std::cout << std::endl;
+        printValueQueries(args[1], options);
+    }
+    if (options.prefixSumCapacity > 0) {
+        std::cout << std::endl;
+        printWindowSums(args[1], n, options);
+    }
 
     timeval elapsed; // Elapsed time
     gettimeofday(&elapsed, nullptr);
@@ -0,0 +1,73 @@
+#ifndef PROTOCOL_H
+#define PROTOCOL_H
+
+#include <cstdint>
+#include <cstring> // memcpy
+#include <string>
+#include <vector>
+
+// Binary protocol of the key-value server, over a Unix stream socket.
+// Every message is a fixed header followed by count 32-bit integers in
+// host byte order (client and server share the host). Clients may send
+// any number of requests before reading; responses come back in request
+// order on each connection.
+//
+//   Request          Payload                      Response payload
+//   GET              key                          value
+//   MULTI_GET        key x count                  value x count
+//   PUT              (key, value) x count / 2     -
+//   SCAN             start, length                records read
+//
+// Missing keys read as 0, as with Database::get().
+
+const std::string DEFAULT_SOCKET_PATH = "./db/kv.sock";
+
+enum RequestOp : uint8_t {
+    OP_GET = 1,
+    OP_MULTI_GET = 2,
+    OP_PUT = 3,
+    OP_SCAN = 4
+};
+
+enum ResponseStatus : uint8_t {
+    STATUS_OK = 0,
+    STATUS_BAD_REQUEST = 1 // Unknown op or bad count; the connection is closed after it
+};
+
+struct MessageHeader {
+    uint8_t op; // RequestOp, or ResponseStatus in a response
+    uint8_t reserved[3];
+    uint32_t count; // int32 payload values that follow
+};
+
+const uint32_t MAX_PAYLOAD = 1 << 16; // Values per message
+
+// Number of payload values a request with this header must carry, or -1
+// if it is invalid
+inline long long requestPayload(const MessageHeader& header) {
+    switch (header.op) {
+    case OP_GET:
+        return header.count == 1 ? 1 : -1;
+    case OP_MULTI_GET:
+        return header.count >= 1 && header.count <= MAX_PAYLOAD ? header.count : -1;
+    case OP_PUT:
+        return header.count >= 2 && header.count <= MAX_PAYLOAD && header.count % 2 == 0 ? header.count : -1;
+    case OP_SCAN:
+        return header.count == 2 ? 2 : -1;
+    default:
+        return -1;
+    }
+}
+
+// Append a message to out
+inline void appendMessage(std::vector<char>& out, uint8_t op, const int32_t* payload, uint32_t count) {
+    MessageHeader header = {op, {0, 0, 0}, count};
+    size_t offset = out.size();
+    out.resize(offset + sizeof(header) + count * sizeof(int32_t));
+    std::memcpy(out.data() + offset, &header, sizeof(header));
+    if (count > 0) {
+        std::memcpy(out.data() + offset + sizeof(header), payload, count * sizeof(int32_t));
+    }
+}
+
+#endif
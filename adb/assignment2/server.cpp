@@ -0,0 +1,355 @@
+#include <algorithm>
+#include <cerrno>
+#include <csignal>
+#include <cstdint>
+#include <cstring> // memcpy, strerror
+#include <exception>
+#include <fcntl.h> // fcntl
+#include <iostream>
+#include <poll.h>
+#include <string>
+#include <sys/socket.h>
+#include <sys/un.h> // sockaddr_un
+#include <unistd.h> // read, write, close, unlink
+#include <utility>
+#include <vector>
+
+#include "database.h"
+#include "protocol.h"
+
+// Key-value server: one long-running process owns the Database, and with
+// it one warm cache, and serves any number of client processes over a
+// Unix domain socket (see protocol.h). Each turn of the event loop reads
+// whatever every connection has sent and then executes the requests in
+// batches: the leading reads of all connections become one multiGet(),
+// the leading puts one pass of puts in key order, and so on until every
+// request is answered. Requests of one connection keep their order.
+
+const uint8_t OP_BAD_REQUEST = 0; // Request::op of a malformed request
+
+// A connection is not read while this much of its input is unparsed or of
+// its output unsent, so a client that sends without reading its responses
+// cannot make the server buffer without bound. Larger than the largest
+// message, so a partly received request can always complete.
+const size_t MAX_BUFFERED = 1 << 20;
+
+struct Request {
+    uint8_t op;
+    uint32_t count;
+    size_t offset; // First payload value in Connection::args
+};
+
+struct Connection {
+    int fd;
+    std::vector<char> in; // Received bytes not yet parsed
+    std::vector<char> out; // Responses not yet sent
+    size_t sent = 0; // Bytes of out already sent
+    std::vector<Request> requests; // Parsed, to be executed this turn
+    std::vector<int32_t> args; // Payloads of requests
+    size_t next = 0; // First request not yet executed
+    bool closing = false; // Read nothing more, close once out is sent
+    bool closed = false; // Peer gone or error
+};
+
+struct ServerStats {
+    long long requests = 0;
+    long long keys = 0; // Keys read or written
+    long long readKeys = 0; // Keys read by multiGet()
+    long long readBatches = 0; // multiGet() calls
+    long long writeBatches = 0;
+};
+
+volatile std::sig_atomic_t stopping = 0;
+
+void onSignal(int) {
+    stopping = 1;
+}
+
+inline bool isRead(uint8_t op) {
+    return op == OP_GET || op == OP_MULTI_GET;
+}
+
+void setNonBlocking(int fd) {
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+}
+
+int listenOn(const std::string& path) {
+    sockaddr_un addr = {};
+    addr.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(addr.sun_path)) {
+        std::cerr << "Error: Socket path " << path << " is too long.\n";
+        std::exit(1);
+    }
+    std::memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    ::unlink(path.c_str()); // Left over by a server that did not shut down
+    if (fd < 0 || bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 || listen(fd, SOMAXCONN) != 0) {
+        std::cerr << "Error: Unable to listen on " << path << ": " << std::strerror(errno) << ".\n";
+        std::exit(1);
+    }
+    setNonBlocking(fd);
+    return fd;
+}
+
+// Read what is available, up to MAX_BUFFERED; false on error. At the end
+// of input the connection is closing, its requests are still answered.
+bool receive(Connection& c) {
+    char buffer[64 * 1024];
+    while (c.in.size() < MAX_BUFFERED) {
+        ssize_t n = ::read(c.fd, buffer, sizeof(buffer));
+        if (n > 0) {
+            c.in.insert(c.in.end(), buffer, buffer + n);
+        } else if (n == 0) {
+            c.closing = true;
+            return true;
+        } else if (errno == EINTR) {
+            continue;
+        } else {
+            return errno == EAGAIN || errno == EWOULDBLOCK;
+        }
+    }
+    return true;
+}
+
+// Send as much of out as the socket takes; false on error
+bool transmit(Connection& c) {
+    while (c.sent < c.out.size()) {
+        ssize_t n = send(c.fd, c.out.data() + c.sent, c.out.size() - c.sent, MSG_NOSIGNAL);
+        if (n > 0) {
+            c.sent += n;
+        } else if (n < 0 && errno == EINTR) {
+            continue;
+        } else {
+            return n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK);
+        }
+    }
+    c.out.clear();
+    c.sent = 0;
+    return true;
+}
+
+// Split received bytes into complete requests. A malformed request is
+// answered with STATUS_BAD_REQUEST, after the requests before it, and
+// anything received after it is dropped.
+void parse(Connection& c) {
+    size_t pos = 0;
+    while (c.in.size() - pos >= sizeof(MessageHeader)) {
+        MessageHeader header;
+        std::memcpy(&header, c.in.data() + pos, sizeof(header));
+        long long count = requestPayload(header);
+        if (count < 0) {
+            c.requests.push_back({OP_BAD_REQUEST, 0, 0});
+            c.closing = true;
+            c.in.clear();
+            return;
+        }
+
+        size_t size = sizeof(header) + count * sizeof(int32_t);
+        if (c.in.size() - pos < size) {
+            break; // Rest arrives later
+        }
+        Request request = {header.op, header.count, c.args.size()};
+        c.args.resize(c.args.size() + count);
+        std::memcpy(c.args.data() + request.offset, c.in.data() + pos + sizeof(header), count * sizeof(int32_t));
+        c.requests.push_back(request);
+        pos += size;
+    }
+    c.in.erase(c.in.begin(), c.in.begin() + pos);
+}
+
+// Execute the parsed requests of all connections, batching across them
+void execute(Database& database, std::vector<Connection>& connections, ServerStats& stats) {
+    std::vector<int> keys;
+    std::vector<int> values;
+    std::vector<std::pair<int, int>> records;
+    std::vector<std::pair<Connection*, const Request*>> taken;
+
+    for (bool progress = true; progress;) {
+        progress = false;
+
+        // Leading reads of every connection, as one multiGet()
+        keys.clear();
+        taken.clear();
+        for (Connection& c : connections) {
+            for (; c.next < c.requests.size() && isRead(c.requests[c.next].op); ++c.next) {
+                const Request& r = c.requests[c.next];
+                keys.insert(keys.end(), c.args.begin() + r.offset, c.args.begin() + r.offset + r.count);
+                taken.emplace_back(&c, &r);
+            }
+        }
+        if (!keys.empty()) {
+            values.resize(keys.size());
+            database.multiGet(keys.data(), values.data(), keys.size());
+            size_t offset = 0;
+            for (const auto& t : taken) {
+                appendMessage(t.first->out, STATUS_OK, values.data() + offset, t.second->count);
+                offset += t.second->count;
+            }
+            stats.keys += keys.size();
+            stats.readKeys += keys.size();
+            stats.requests += taken.size();
+            ++stats.readBatches;
+            progress = true;
+        }
+
+        // Leading puts of every connection, written in key order. The sort
+        // is stable, so of two puts of one key the later one wins.
+        records.clear();
+        taken.clear();
+        for (Connection& c : connections) {
+            for (; c.next < c.requests.size() && c.requests[c.next].op == OP_PUT; ++c.next) {
+                const Request& r = c.requests[c.next];
+                for (uint32_t i = 0; i < r.count; i += 2) {
+                    records.emplace_back(c.args[r.offset + i], c.args[r.offset + i + 1]);
+                }
+                taken.emplace_back(&c, &r);
+            }
+        }
+        if (!records.empty()) {
+            std::stable_sort(records.begin(), records.end(),
+                             [](const std::pair<int, int>& a, const std::pair<int, int>& b) { return a.first < b.first; });
+            for (const std::pair<int, int>& record : records) {
+                database.put(record.first, record.second);
+            }
+            for (const auto& t : taken) {
+                appendMessage(t.first->out, STATUS_OK, nullptr, 0);
+            }
+            stats.keys += records.size();
+            stats.requests += taken.size();
+            ++stats.writeBatches;
+            progress = true;
+        }
+
+        // Scans, one at a time
+        for (Connection& c : connections) {
+            for (; c.next < c.requests.size() && c.requests[c.next].op == OP_SCAN; ++c.next) {
+                const Request& r = c.requests[c.next];
+                int32_t read = database.scan(c.args[r.offset], c.args[r.offset + 1]);
+                appendMessage(c.out, STATUS_OK, &read, 1);
+                stats.keys += read;
+                ++stats.requests;
+                progress = true;
+            }
+            if (c.next < c.requests.size() && c.requests[c.next].op == OP_BAD_REQUEST) {
+                appendMessage(c.out, STATUS_BAD_REQUEST, nullptr, 0);
+                ++c.next;
+                progress = true;
+            }
+        }
+    }
+
+    for (Connection& c : connections) {
+        c.requests.clear();
+        c.args.clear();
+        c.next = 0;
+    }
+}
+
+void printUsage(const char* program) {
+    std::cerr << "Usage: " << program << " database_name [options]\n"
+              << "Options:\n"
+              << "  --socket path   Unix socket to listen on (default " << DEFAULT_SOCKET_PATH << ")\n"
+              << "  --cache n       Cache size in bytes (default 16 MB)\n"
+              << "  --buffer n      Buffer up to n puts in memory, written in key order\n"
+              << "Stop with SIGINT or SIGTERM.\n";
+}
+
+int main(const int argc, const char* argv[]) {
+    if (argc < 2) {
+        printUsage(argv[0]);
+        std::exit(1);
+    }
+
+    std::string socketPath = DEFAULT_SOCKET_PATH;
+    DatabaseOptions options;
+    options.cacheSize = 16 * 1024 * 1024; // Shared by every client, so worth a larger one
+    try {
+        for (int i = 2; i < argc; ++i) {
+            std::string option = argv[i];
+            if (i + 1 >= argc) {
+                throw std::invalid_argument(option);
+            }
+
+            std::string value = argv[++i];
+            if (option == "--socket") {
+                socketPath = value;
+            } else if (option == "--cache") {
+                options.cacheSize = std::stoull(value);
+            } else if (option == "--buffer") {
+                options.bufferCapacity = std::max(0, std::stoi(value));
+            } else {
+                throw std::invalid_argument(option);
+            }
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Error: Invalid option " << e.what() << ".\n";
+        printUsage(argv[0]);
+        std::exit(1);
+    }
+
+    Database* database = new Database(argv[1], options);
+    int listenFd = listenOn(socketPath);
+    std::signal(SIGINT, onSignal);
+    std::signal(SIGTERM, onSignal);
+    std::cout << "Listening on " << socketPath << "..." << std::endl;
+
+    ServerStats stats;
+    std::vector<Connection> connections;
+    std::vector<pollfd> fds;
+    while (!stopping) {
+        fds.clear();
+        fds.push_back({listenFd, POLLIN, 0});
+        for (const Connection& c : connections) {
+            bool reading = !c.closing && c.in.size() < MAX_BUFFERED && c.out.size() < MAX_BUFFERED;
+            fds.push_back({c.fd, static_cast<short>((reading ? POLLIN : 0) | (c.out.empty() ? 0 : POLLOUT)), 0});
+        }
+        if (poll(fds.data(), fds.size(), 1000) < 0) {
+            continue; // EINTR, stopping is checked above
+        }
+
+        for (size_t i = 0; i < connections.size(); ++i) {
+            if ((fds[i + 1].events & POLLIN) && (fds[i + 1].revents & (POLLIN | POLLHUP | POLLERR))) {
+                connections[i].closed = !receive(connections[i]);
+            }
+            parse(connections[i]);
+        }
+        execute(*database, connections, stats);
+        for (Connection& c : connections) {
+            if (!c.closed && !transmit(c)) {
+                c.closed = true;
+            }
+            if (c.closing && c.out.empty()) {
+                c.closed = true;
+            }
+            if (c.closed) {
+                ::close(c.fd);
+            }
+        }
+        connections.erase(std::remove_if(connections.begin(), connections.end(),
+                                         [](const Connection& c) { return c.closed; }),
+                          connections.end());
+
+        // New connections are served from the next turn
+        if (fds[0].revents & POLLIN) {
+            for (int fd; (fd = accept(listenFd, nullptr, nullptr)) >= 0;) {
+                setNonBlocking(fd);
+                connections.emplace_back();
+                connections.back().fd = fd;
+            }
+        }
+    }
+
+    std::cout << "\nShutting down..." << std::endl;
+    for (const Connection& c : connections) {
+        ::close(c.fd);
+    }
+    ::close(listenFd);
+    ::unlink(socketPath.c_str());
+
+    std::cout << "Requests: " << stats.requests << ", keys: " << stats.keys << ", read batches: " << stats.readBatches
+              << " (" << (stats.readBatches > 0 ? static_cast<double>(stats.readKeys) / stats.readBatches : 0)
+              << " keys per batch), write batches: " << stats.writeBatches << std::endl;
+    delete database; // Writes out buffered puts
+    return 0;
+}
@@ -0,0 +1,161 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <exception>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "database.h"
+
+// Cold vs. warm startup benchmark: times opening the database and its
+// first queries after the caches were dropped, without warm-up, with a
+// sequential preload of the files and with a replay of the hot keys
+// recorded by an earlier, untimed run. That run draws its keys from the
+// same distribution as the timed queries but with another seed, so the
+// replay is measured on keys it was not recorded from.
+
+enum WarmUpMode {
+    COLD, // No warm-up
+    SEQUENTIAL, // Preload the files in page order
+    HOT_KEYS, // Replay key ranges recorded by the recording run
+    MODE_COUNT
+};
+
+const char* modeNames[MODE_COUNT] = {"cold", "sequential", "hot keys"};
+
+const unsigned RECORD_SEED = 42; // Keys of the run that records the hot keys
+const unsigned QUERY_SEED = 43; // Keys of the timed queries
+
+struct WarmupConfig {
+    std::string dbName;
+    int recordCount = 100000; // Keys [0, recordCount) are queried
+    int queryCount = 10000; // Queries timed after each open
+    size_t cacheSize = 16 * 1024 * 1024; // Cache bytes, large enough to be worth warming
+    bool load = false; // Insert recordCount records first
+};
+
+struct StartupTimes {
+    double open = 0; // Milliseconds
+    double warmUp = 0;
+    size_t warmed = 0; // Pages or key ranges loaded
+    double queries = 0;
+};
+
+double millisecondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Open after dropping all caches, optionally warm up, then run the random
+// queries of seed, the same in every mode
+StartupTimes measureStartup(const WarmupConfig& config, const DatabaseOptions& options, WarmUpMode mode,
+                            unsigned seed) {
+    Database::dropCaches(config.dbName);
+
+    StartupTimes times;
+    auto start = std::chrono::steady_clock::now();
+    Database* database = new Database(config.dbName, options);
+    times.open = millisecondsSince(start);
+
+    if (mode != COLD) {
+        start = std::chrono::steady_clock::now();
+        times.warmed = database->warmUp(mode == HOT_KEYS);
+        times.warmUp = millisecondsSince(start);
+    }
+
+    std::mt19937 random(seed);
+    std::uniform_int_distribution<int> keys(0, config.recordCount - 1);
+    long long sum = 0;
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < config.queryCount; ++i) {
+        sum += database->get(keys(random));
+    }
+    times.queries = millisecondsSince(start);
+    std::cout << "Checksum = " << sum << std::endl; // Keeps the reads
+
+    delete database;
+    return times;
+}
+
+void printUsage(const char* program) {
+    std::cerr << "Usage: " << program << " database_name [options]\n"
+              << "Options:\n"
+              << "  --records n   Records queried, keys [0, n) (default 100000)\n"
+              << "  --load        Insert the records first\n"
+              << "  --queries n   Queries timed after each open (default 10000)\n"
+              << "  --cache n     Cache size in bytes (default 16 MB)\n";
+}
+
+int main(const int argc, const char* argv[]) {
+    if (argc < 2) {
+        printUsage(argv[0]);
+        std::exit(1);
+    }
+
+    WarmupConfig config;
+    config.dbName = argv[1];
+    try {
+        for (int i = 2; i < argc; ++i) {
+            std::string option = argv[i];
+            if (option == "--load") {
+                config.load = true;
+                continue;
+            }
+            if (i + 1 >= argc) {
+                throw std::invalid_argument(option);
+            }
+
+            std::string value = argv[++i];
+            if (option == "--records") {
+                config.recordCount = std::max(1, std::stoi(value));
+            } else if (option == "--queries") {
+                config.queryCount = std::max(1, std::stoi(value));
+            } else if (option == "--cache") {
+                config.cacheSize = std::stoull(value);
+            } else {
+                throw std::invalid_argument(option);
+            }
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Error: Invalid option " << e.what() << ".\n";
+        printUsage(argv[0]);
+        std::exit(1);
+    }
+
+    DatabaseOptions options;
+    options.cacheSize = config.cacheSize;
+
+    if (config.load) {
+        std::cout << "Loading " << config.recordCount << " records..." << std::endl;
+        Database* database = new Database(config.dbName, options);
+        std::mt19937 random(std::random_device{}());
+        for (int i = 0; i < config.recordCount; ++i) {
+            database->put(i, random() % INT32_MAX);
+        }
+        delete database;
+    }
+
+    // Record the key ranges read for the hot-key replay
+    std::cout << "\nRecording hot keys..." << std::endl;
+    DatabaseOptions recordOptions = options;
+    recordOptions.recordHotKeys = true;
+    measureStartup(config, recordOptions, COLD, RECORD_SEED);
+
+    std::vector<StartupTimes> results;
+    for (int mode = 0; mode < MODE_COUNT; ++mode) {
+        std::cout << "\nStarting " << modeNames[mode] << "..." << std::endl;
+        results.push_back(measureStartup(config, options, static_cast<WarmUpMode>(mode), QUERY_SEED));
+    }
+
+    std::cout << "\nMode\t\tOpen(ms)\tWarm-up(ms)\tLoaded\tFirst " << config.queryCount << " queries(ms)\tTotal(ms)\n";
+    std::cout << std::fixed << std::setprecision(2);
+    for (int mode = 0; mode < MODE_COUNT; ++mode) {
+        const StartupTimes& t = results[mode];
+        std::cout << modeNames[mode] << (mode == COLD ? "\t\t" : "\t") << t.open << "\t\t" << t.warmUp << "\t\t"
+                  << t.warmed << '\t' << t.queries << "\t\t\t" << t.open + t.warmUp + t.queries << '\n';
+    }
+
+    return 0;
+}
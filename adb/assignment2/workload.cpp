@@ -0,0 +1,470 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <exception>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "database.h"
+
+// YCSB-style workload driver: runs a configurable mix of reads, updates,
+// inserts and scans against a Database with a chosen key distribution and
+// reports throughput and latency percentiles per operation type.
+
+enum Operation {
+    OP_READ,
+    OP_UPDATE,
+    OP_INSERT,
+    OP_SCAN,
+    OP_COUNT
+};
+
+const char* operationNames[OP_COUNT] = {"READ", "UPDATE", "INSERT", "SCAN"};
+
+enum class Distribution {
+    UNIFORM,
+    ZIPFIAN,
+    LATEST,
+    SEQUENTIAL
+};
+
+struct WorkloadConfig {
+    std::string dbName;
+    int recordCount = 100000; // Keys [0, recordCount) exist before the run
+    long long operationCount = 1000000; // Total operations, unless duration is set
+    double duration = 0; // Run time in seconds, 0 = use operationCount
+    int threads = 1;
+    int scanLength = 100; // Maximum records per scan
+    int bufferCapacity = 0; // Database write buffer size, 0 = write through
+    StorageEngine engine = StorageEngine::BDB;
+    bool load = false; // Insert recordCount records before the run
+    bool snapshotReads = false; // Scans read a snapshot instead of locking out updates
+    Distribution distribution = Distribution::UNIFORM;
+    double mix[OP_COUNT] = {0.95, 0.05, 0, 0}; // Proportion of each operation
+};
+
+// xoshiro256** generator seeded through splitmix64. Each worker owns one,
+// so there is no shared state as with std::rand().
+class Random {
+  private:
+    uint64_t mState[4];
+
+    static uint64_t rotl(uint64_t x, int k) { return (x << k) | (x >> (64 - k)); }
+
+  public:
+    explicit Random(uint64_t seed) {
+        for (uint64_t& s : mState) {
+            seed += 0x9e3779b97f4a7c15ULL;
+            uint64_t z = seed;
+            z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+            z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+            s = z ^ (z >> 31);
+        }
+    }
+
+    uint64_t next() {
+        uint64_t result = rotl(mState[1] * 5, 7) * 9;
+        uint64_t t = mState[1] << 17;
+        mState[2] ^= mState[0];
+        mState[3] ^= mState[1];
+        mState[1] ^= mState[2];
+        mState[0] ^= mState[3];
+        mState[2] ^= t;
+        mState[3] = rotl(mState[3], 45);
+        return result;
+    }
+
+    // Uniform double in [0, 1)
+    double nextDouble() { return (next() >> 11) * 0x1.0p-53; }
+
+    // Uniform integer in [0, n)
+    uint64_t nextBelow(uint64_t n) { return static_cast<uint64_t>((static_cast<unsigned __int128>(next()) * n) >> 64); }
+};
+
+// Zipfian ranks over [0, items) with the generator of Gray et al. used by
+// YCSB; rank 0 is the most popular. Setup costs O(items), each draw O(1).
+class ZipfianGenerator {
+  private:
+    uint64_t mItems;
+    double mTheta;
+    double mZetan;
+    double mAlpha;
+    double mEta;
+
+    static double zeta(uint64_t n, double theta) {
+        double sum = 0;
+        for (uint64_t i = 1; i <= n; ++i) {
+            sum += 1.0 / std::pow(static_cast<double>(i), theta);
+        }
+        return sum;
+    }
+
+  public:
+    ZipfianGenerator(uint64_t items, double theta = 0.99) : mItems(std::max<uint64_t>(items, 1)), mTheta(theta) {
+        mZetan = zeta(mItems, theta);
+        mAlpha = 1.0 / (1.0 - theta);
+        mEta = (1 - std::pow(2.0 / mItems, 1 - theta)) / (1 - zeta(2, theta) / mZetan);
+    }
+
+    uint64_t next(Random& random) const {
+        double u = random.nextDouble();
+        double uz = u * mZetan;
+        if (uz < 1.0) {
+            return 0;
+        }
+        if (uz < 1.0 + std::pow(0.5, mTheta)) {
+            return 1;
+        }
+        uint64_t rank = static_cast<uint64_t>(mItems * std::pow(mEta * u - mEta + 1, mAlpha));
+        return std::min(rank, mItems - 1);
+    }
+};
+
+// Latency histogram with logarithmic buckets: every power of two is split
+// into 16 linear sub-buckets, giving ~6% resolution in fixed memory.
+class LatencyHistogram {
+  private:
+    std::vector<uint64_t> mBuckets;
+    uint64_t mCount;
+    uint64_t mTotal; // Sum of latencies in ns
+    uint64_t mMax;
+
+    static int bucketOf(uint64_t ns) {
+        if (ns < 16) {
+            return ns;
+        }
+        int e = 63 - __builtin_clzll(ns); // e >= 4
+        return (e - 3) * 16 + ((ns >> (e - 4)) & 15);
+    }
+
+    static uint64_t bucketValue(int bucket) {
+        if (bucket < 16) {
+            return bucket;
+        }
+        int e = bucket / 16 + 3;
+        return static_cast<uint64_t>(16 + bucket % 16) << (e - 4);
+    }
+
+  public:
+    LatencyHistogram() : mBuckets(61 * 16, 0), mCount(0), mTotal(0), mMax(0) {}
+
+    void record(uint64_t ns) {
+        ++mBuckets[bucketOf(ns)];
+        ++mCount;
+        mTotal += ns;
+        mMax = std::max(mMax, ns);
+    }
+
+    void merge(const LatencyHistogram& other) {
+        for (size_t i = 0; i < mBuckets.size(); ++i) {
+            mBuckets[i] += other.mBuckets[i];
+        }
+        mCount += other.mCount;
+        mTotal += other.mTotal;
+        mMax = std::max(mMax, other.mMax);
+    }
+
+    // Latency in ns at quantile q in [0, 1]
+    uint64_t percentile(double q) const {
+        uint64_t target = static_cast<uint64_t>(std::ceil(q * mCount));
+        uint64_t seen = 0;
+        for (size_t i = 0; i < mBuckets.size(); ++i) {
+            seen += mBuckets[i];
+            if (seen >= target && seen > 0) {
+                return std::min(bucketValue(i), mMax);
+            }
+        }
+        return mMax;
+    }
+
+    uint64_t count() const { return mCount; }
+    double mean() const { return mCount ? double(mTotal) / mCount : 0; }
+    uint64_t max() const { return mMax; }
+};
+
+// State shared by all workers
+struct WorkloadState {
+    std::atomic<int> keyCount; // Keys [0, keyCount) have been inserted
+    std::shared_mutex lock; // Readers shared, writers exclusive
+    std::chrono::steady_clock::time_point deadline;
+};
+
+// 64-bit FNV-1a of a rank, used to scatter zipfian hot keys over the keyspace
+inline uint64_t scramble(uint64_t value) {
+    uint64_t hash = 14695981039346656037ULL;
+    for (int i = 0; i < 8; ++i) {
+        hash = (hash ^ (value & 0xff)) * 1099511628211ULL;
+        value >>= 8;
+    }
+    return hash;
+}
+
+// Pick an existing key according to the configured distribution
+inline int chooseKey(const WorkloadConfig& config, const ZipfianGenerator& zipfian, WorkloadState& state,
+                     Random& random, uint64_t& sequence) {
+    uint64_t limit = std::max(state.keyCount.load(std::memory_order_relaxed), 1);
+    switch (config.distribution) {
+    case Distribution::ZIPFIAN:
+        return scramble(zipfian.next(random)) % limit;
+    case Distribution::LATEST: // Most recently inserted keys are the hottest
+        return limit - 1 - std::min(zipfian.next(random), limit - 1);
+    case Distribution::SEQUENTIAL:
+        return sequence++ % limit;
+    case Distribution::UNIFORM:
+    default:
+        return random.nextBelow(limit);
+    }
+}
+
+void runWorker(Database& database, const WorkloadConfig& config, const ZipfianGenerator& zipfian,
+               WorkloadState& state, int id, long long operations, std::vector<LatencyHistogram>& latencies) {
+    Random random(std::chrono::steady_clock::now().time_since_epoch().count() + id * 0x9e3779b97f4a7c15ULL);
+    uint64_t sequence = static_cast<uint64_t>(id) * config.recordCount / config.threads;
+
+    // Cumulative operation mix
+    double cumulative[OP_COUNT];
+    double total = 0;
+    for (int op = 0; op < OP_COUNT; ++op) {
+        total += config.mix[op];
+        cumulative[op] = total;
+    }
+
+    for (long long done = 0; config.duration > 0 || done < operations; ++done) {
+        double pick = random.nextDouble() * total;
+        int op = 0;
+        while (op < OP_COUNT - 1 && pick >= cumulative[op]) {
+            ++op;
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        if (config.duration > 0 && start >= state.deadline) {
+            break;
+        }
+
+        // Without snapshot reads the environment has no locking subsystem,
+        // so state.lock keeps a writer from running concurrently with any
+        // other access. With them Berkeley DB locks pages itself and scans
+        // read a snapshot, so updates and scans overlap and nothing is held
+        // here.
+        bool locking = !config.snapshotReads;
+        std::shared_lock<std::shared_mutex> readGuard(state.lock, std::defer_lock);
+        std::unique_lock<std::shared_mutex> writeGuard(state.lock, std::defer_lock);
+        switch (op) {
+        case OP_READ: {
+            if (locking) {
+                readGuard.lock();
+            }
+            database.get(chooseKey(config, zipfian, state, random, sequence));
+            break;
+        }
+        case OP_UPDATE: {
+            int key = chooseKey(config, zipfian, state, random, sequence);
+            if (locking) {
+                writeGuard.lock();
+            }
+            database.put(key, random.next() % INT32_MAX);
+            break;
+        }
+        case OP_INSERT: {
+            if (!locking) {
+                // Readers may pick the key before its put lands and read 0
+                database.put(state.keyCount.fetch_add(1), random.next() % INT32_MAX);
+                break;
+            }
+            writeGuard.lock();
+            int key = state.keyCount.load(std::memory_order_relaxed);
+            database.put(key, random.next() % INT32_MAX);
+            state.keyCount.store(key + 1, std::memory_order_relaxed);
+            break;
+        }
+        case OP_SCAN: {
+            int key = chooseKey(config, zipfian, state, random, sequence);
+            int length = 1 + random.nextBelow(config.scanLength);
+            if (locking && config.bufferCapacity > 0) {
+                writeGuard.lock(); // Scans flush the write buffer, which makes them writers
+            } else if (locking) {
+                readGuard.lock();
+            }
+            database.scan(key, length); // In a snapshot transaction of its own with snapshot reads
+            break;
+        }
+        }
+
+        auto end = std::chrono::steady_clock::now();
+        latencies[op].record(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+    }
+}
+
+void printReport(const std::vector<LatencyHistogram>& latencies, double seconds) {
+    uint64_t total = 0;
+    for (const LatencyHistogram& h : latencies) {
+        total += h.count();
+    }
+
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << "Operations: " << total << " in " << seconds << "s\n";
+    std::cout << "Throughput: " << total / seconds << " ops/sec\n\n";
+    std::cout << "Latency (us)\tCount\tAvg\tp50\tp95\tp99\tp99.9\tMax\n";
+    for (int op = 0; op < OP_COUNT; ++op) {
+        const LatencyHistogram& h = latencies[op];
+        if (h.count() == 0) {
+            continue;
+        }
+        std::cout << operationNames[op] << "\t\t" << h.count() << '\t' << h.mean() / 1000 << '\t'
+                  << h.percentile(0.50) / 1000.0 << '\t' << h.percentile(0.95) / 1000.0 << '\t'
+                  << h.percentile(0.99) / 1000.0 << '\t' << h.percentile(0.999) / 1000.0 << '\t'
+                  << h.max() / 1000.0 << '\n';
+    }
+}
+
+void printUsage(const char* program) {
+    std::cerr << "Usage: " << program << " database_name [options]\n"
+              << "Options:\n"
+              << "  --records n        Records present before the run (default 100000)\n"
+              << "  --load             Insert the records before the run\n"
+              << "  --snapshot         Scans read a snapshot, concurrently with updates\n"
+              << "  --operations n     Total operations (default 1000000)\n"
+              << "  --duration s       Run for s seconds instead of a fixed operation count\n"
+              << "  --threads n        Worker threads (default 1)\n"
+              << "  --distribution d   uniform, zipfian, latest or sequential (default uniform)\n"
+              << "  --read p --update p --insert p --scan p\n"
+              << "                     Operation mix proportions (default 0.95 read, 0.05 update)\n"
+              << "  --scan-length n    Maximum records per scan (default 100)\n"
+              << "  --buffer n         Buffer up to n puts in memory, written in key order\n"
+              << "  --storage e        Storage engine: bdb (default), memory or mmap (no scans)\n";
+}
+
+int main(const int argc, const char* argv[]) {
+    if (argc < 2) {
+        printUsage(argv[0]);
+        std::exit(1);
+    }
+
+    WorkloadConfig config;
+    config.dbName = argv[1];
+    try {
+        for (int i = 2; i < argc; ++i) {
+            std::string option = argv[i];
+            if (option == "--load") {
+                config.load = true;
+                continue;
+            }
+            if (option == "--snapshot") {
+                config.snapshotReads = true;
+                continue;
+            }
+            if (i + 1 >= argc) {
+                throw std::invalid_argument(option);
+            }
+
+            std::string value = argv[++i];
+            if (option == "--records") {
+                config.recordCount = std::stoi(value);
+            } else if (option == "--operations") {
+                config.operationCount = std::stoll(value);
+            } else if (option == "--duration") {
+                config.duration = std::stod(value);
+            } else if (option == "--threads") {
+                config.threads = std::max(1, std::stoi(value));
+            } else if (option == "--buffer") {
+                config.bufferCapacity = std::max(0, std::stoi(value));
+            } else if (option == "--storage") {
+                if (!parseStorageEngine(value, config.engine)) {
+                    throw std::invalid_argument(value);
+                }
+            } else if (option == "--scan-length") {
+                config.scanLength = std::max(1, std::stoi(value));
+            } else if (option == "--read") {
+                config.mix[OP_READ] = std::stod(value);
+            } else if (option == "--update") {
+                config.mix[OP_UPDATE] = std::stod(value);
+            } else if (option == "--insert") {
+                config.mix[OP_INSERT] = std::stod(value);
+            } else if (option == "--scan") {
+                config.mix[OP_SCAN] = std::stod(value);
+            } else if (option == "--distribution") {
+                if (value == "uniform") {
+                    config.distribution = Distribution::UNIFORM;
+                } else if (value == "zipfian") {
+                    config.distribution = Distribution::ZIPFIAN;
+                } else if (value == "latest") {
+                    config.distribution = Distribution::LATEST;
+                } else if (value == "sequential") {
+                    config.distribution = Distribution::SEQUENTIAL;
+                } else {
+                    throw std::invalid_argument(value);
+                }
+            } else {
+                throw std::invalid_argument(option);
+            }
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Error: Invalid option " << e.what() << ".\n";
+        printUsage(argv[0]);
+        std::exit(1);
+    }
+
+    if (config.mix[OP_READ] + config.mix[OP_UPDATE] + config.mix[OP_INSERT] + config.mix[OP_SCAN] <= 0) {
+        std::cerr << "Error: Operation mix is empty.\n";
+        std::exit(1);
+    }
+
+    DatabaseOptions options;
+    options.bufferCapacity = config.bufferCapacity;
+    options.engine = config.engine;
+    options.snapshotReads = config.snapshotReads;
+    Database* database = new Database(config.dbName, options);
+
+    if (config.load) {
+        std::cout << "Loading " << config.recordCount << " records..." << std::endl;
+        Random random(std::chrono::steady_clock::now().time_since_epoch().count());
+        for (int i = 0; i < config.recordCount; ++i) {
+            database->put(i, random.next() % INT32_MAX);
+        }
+    }
+
+    std::cout << "Preparing key distribution..." << std::endl;
+    ZipfianGenerator zipfian(config.recordCount);
+
+    WorkloadState state;
+    state.keyCount = config.recordCount;
+
+    std::cout << "Running workload with " << config.threads << " thread(s)..." << std::endl;
+    std::vector<std::vector<LatencyHistogram>> latencies(config.threads, std::vector<LatencyHistogram>(OP_COUNT));
+    std::vector<std::thread> workers;
+    auto start = std::chrono::steady_clock::now();
+    state.deadline = start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                                 std::chrono::duration<double>(config.duration));
+    for (int t = 0; t < config.threads; ++t) {
+        // Split the operation count evenly, the first threads take the remainder
+        long long operations = config.operationCount / config.threads + (t < config.operationCount % config.threads);
+        workers.emplace_back(runWorker, std::ref(*database), std::cref(config), std::cref(zipfian), std::ref(state), t,
+                             operations, std::ref(latencies[t]));
+    }
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::vector<LatencyHistogram> merged(OP_COUNT);
+    for (const std::vector<LatencyHistogram>& perThread : latencies) {
+        for (int op = 0; op < OP_COUNT; ++op) {
+            merged[op].merge(perThread[op]);
+        }
+    }
+
+    std::cout << std::endl;
+    printReport(merged, seconds);
+    std::cout << std::endl;
+
+    delete database;
+
+    return 0;
+}
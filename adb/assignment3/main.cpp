@@ -1,165 +1,1218 @@
-#include <ctime>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cerrno>
+#include <charconv> // to_chars, from_chars
+#include <chrono>
+#include <cmath> // abs
+#include <cstdint>
 #include <cstring> // memcpy
+#include <ctime>
 #include <db_cxx.h> // Berkeley DB
+#include <fcntl.h> // open
 #include <iostream>
+#include <memory> // shared_ptr
 #include <random> // srand, rand
 #include <string>
+#include <sys/socket.h> // socketpair
+#include <sys/stat.h> // mkdir
 #include <sys/time.h> // gettimeofday
+#include <sys/wait.h> // waitpid
+#include <thread>
+#include <type_traits>
+#include <unistd.h> // read, write, close, fork, pipe
+#include <utility> // declval, index_sequence
 #include <vector>
 
+#include "profiler.h"
+#include "ring.h"
+#include "bdb_storage.h"
+#include "storage.h"
+
 enum DbErrorCode {
     DB_SUCCESS,
     DB_ERROR,
 };
 
+// Options of a Database: its storage engine and, with the Berkeley DB
+// settings, how its records are spread over files.
+struct DatabaseOptions : BdbOptions {
+    StorageEngine engine = StorageEngine::BDB;
+    // Split each database into this many files, records spread by a hash
+    // of their key. Partition i is stored in partitionDirs[i % size], or
+    // in home if none are given, e.g. one directory per disk. A database
+    // must be reopened with the partitioning it was written with.
+    int partitions = 1;
+    std::vector<std::string> partitionDirs;
+    // Matrix cells set through a ring of this many pending writes, applied
+    // by a background thread; 0 = set writes through
+    size_t writeBehind = 0;
+};
+
+// Options with the nelem hint set for a matrix of cells cells, unless given
+inline DatabaseOptions expectRecords(DatabaseOptions options, long long cells) {
+    if (options.expectedRecords == 0) {
+        options.expectedRecords = std::min<long long>(cells + 2, UINT32_MAX); // Cells and named records
+    }
+    return options;
+}
+
+// Storage codec of a cell type. Cells are stored as their native bytes,
+// and the encoding id goes into the matrix header so that a matrix is only
+// reopened with the element type it was written with.
+template <typename T>
+struct NativeCodec {
+    static constexpr size_t SIZE = sizeof(T);
+    static void encode(T v, char* data) { std::memcpy(data, &v, SIZE); }
+    static T decode(const void* data) {
+        T v;
+        std::memcpy(&v, data, SIZE);
+        return v;
+    }
+};
+
+template <typename T>
+struct CellCodec; // Only the types below can be stored
+
+template <>
+struct CellCodec<double> : NativeCodec<double> {
+    static constexpr uint32_t ENCODING = 1;
+};
+
+template <>
+struct CellCodec<float> : NativeCodec<float> {
+    static constexpr uint32_t ENCODING = 2;
+};
+
+template <>
+struct CellCodec<int32_t> : NativeCodec<int32_t> {
+    static constexpr uint32_t ENCODING = 3;
+};
+
+template <>
+struct CellCodec<int64_t> : NativeCodec<int64_t> {
+    static constexpr uint32_t ENCODING = 4;
+};
+
+template <>
+struct CellCodec<uint8_t> : NativeCodec<uint8_t> {
+    static constexpr uint32_t ENCODING = 5;
+};
+
+// Storage engine of one database, or of one partition of it, in options.home
+inline Storage* openStorage(const std::string& name, const DatabaseOptions& options) {
+    switch (options.engine) {
+    case StorageEngine::MEMORY:
+        return new MemoryStorage(name);
+    case StorageEngine::MMAP:
+        return new MmapStorage(options.home + "/" + name + ".mmap");
+    case StorageEngine::BDB:
+    default:
+        return new BdbStorage(name, options);
+    }
+}
+
 class Database {
   private:
-    DbEnv* mEnv; // Berkeley DB environment variable
-    Db* mDatabase; // Berkeley DB connection
+    Storage* mStorage; // Storage engine
     std::string dbName;
 
   public:
-    Database(const std::string dbName) : mEnv(nullptr), mDatabase(nullptr), dbName(dbName) {
-        mEnv = new DbEnv(0); // Berkeley DB Environment
-        mEnv->set_error_stream(&std::cerr); // Set error stream
-        mEnv->set_cachesize(0, 64 * 1024, 0); // Allocate cache memory
-
-        try {
-            mEnv->open("./db", DB_CREATE | DB_INIT_MPOOL, 0); // Open environment
-        } catch (const DbException& e) {
-            std::cerr << "Error: Unable to open db.\n";
-            std::cerr << e.what() << std::endl;
-            std::exit(DbErrorCode::DB_ERROR);
-        } catch (const std::exception& e) {
-            std::cerr << "Error: Unable to create environment.\n";
-            std::cerr << e.what() << std::endl;
-            std::exit(DbErrorCode::DB_ERROR);
+    Database(const std::string dbName, const DatabaseOptions& options = DatabaseOptions())
+        : mStorage(nullptr), dbName(dbName) {
+        std::cout << "Opening database " << dbName << "...\n";
+        if (options.partitions <= 1) {
+            mStorage = openStorage(dbName, options);
+            return;
         }
 
-        std::cout << "Opening database " << dbName << "...\n";
-        try {
-            mDatabase = new Db(mEnv, 0); // Database
-            // Open the database
-            mDatabase->open(nullptr, (dbName + ".db").c_str(), nullptr, DB_HASH, DB_CREATE, 0);
-        } catch (const DbException& e) {
-            std::cerr << "Error opening database.\n";
-            std::cerr << e.what() << std::endl;
-            std::exit(DbErrorCode::DB_ERROR);
-        } catch (const std::exception& e) {
-            std::cerr << e.what() << std::endl;
-            std::exit(DbErrorCode::DB_ERROR);
+        // Partition i is the database dbName_pi
+        DatabaseOptions partitionOptions = options;
+        if (options.expectedRecords > 0) {
+            partitionOptions.expectedRecords = options.expectedRecords / options.partitions + 1;
+        }
+        std::vector<Storage*> partitions;
+        for (int i = 0; i < options.partitions; ++i) {
+            if (!options.partitionDirs.empty()) {
+                partitionOptions.home = options.partitionDirs[i % options.partitionDirs.size()];
+            }
+            partitions.push_back(openStorage(dbName + "_p" + std::to_string(i), partitionOptions));
         }
+        mStorage = new PartitionedStorage(partitions);
     }
 
     ~Database() {
         std::cout << "Closing database " << dbName << "...\n";
-        mDatabase->close(0); // Close the database
-        mEnv->close(0); // Close the environment
+        delete mStorage; // Close the storage engine
+    }
+
+    template <typename T = double>
+    T get(const int row, const int col); // Fetch the value
+    template <typename T = double>
+    void put(const int row, const int col, T v); // Store the value
+    bool getRecord(const std::string& name, void* data, size_t size); // Fetch a named record
+    void putRecord(const std::string& name, const void* data, size_t size); // Store a named record
+    void removeRecord(const std::string& name); // Delete a named record
+    void sync(); // Flush dirty pages to disk
+    void printPageReport(); // Records and space used by the storage engine
+};
+
+template <typename T>
+inline T Database::get(const int row, const int col) {
+    // Make key using row and column. Fixed width, so (1, 11) and (11, 1) differ.
+    int k[2] = {row, col};
+    char data[CellCodec<T>::SIZE];
+
+    if (!mStorage->get(k, sizeof(k), data, sizeof(data))) { // Retrieve the value
+        return T();
+    }
+    return CellCodec<T>::decode(data); // Return the value
+}
+
+template <typename T>
+inline void Database::put(const int row, const int col, T v) {
+    // Make key using row and column. Fixed width, so (1, 11) and (11, 1) differ.
+    int k[2] = {row, col};
+    char data[CellCodec<T>::SIZE];
+    CellCodec<T>::encode(v, data);
+
+    mStorage->put(k, sizeof(k), data, sizeof(data)); // Set/update value
+}
+
+// Named records never collide with cells, whose keys are exactly two ints
+inline bool Database::getRecord(const std::string& name, void* data, size_t size) {
+    return mStorage->get(name.data(), name.size(), data, size);
+}
+
+inline void Database::putRecord(const std::string& name, const void* data, size_t size) {
+    mStorage->put(name.data(), name.size(), data, size);
+}
+
+inline void Database::removeRecord(const std::string& name) {
+    mStorage->remove(name.data(), name.size());
+}
+
+inline void Database::sync() {
+    mStorage->sync();
+}
+
+inline void Database::printPageReport() {
+    mStorage->printReport();
+}
+
+// Buffered writer on top of a file descriptor. Values are formatted with
+// std::to_chars straight into a large buffer which is written out with one
+// write(2) call per buffer, instead of one stream flush per line.
+class BufferedWriter {
+  private:
+    int mFd;
+    bool mOwnsFd; // Close the descriptor on destruction
+    std::vector<char> mBuffer;
+    size_t mSize; // Bytes pending in buffer
+
+  public:
+    BufferedWriter(int fd, size_t capacity = 1 << 20) : mFd(fd), mOwnsFd(false), mBuffer(capacity), mSize(0) {}
 
-        delete mDatabase;
-        delete mEnv;
+    BufferedWriter(const std::string& path, size_t capacity = 1 << 20)
+        : mFd(-1), mOwnsFd(true), mBuffer(capacity), mSize(0) {
+        mFd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (mFd < 0) {
+            std::cerr << "Error: Unable to open " << path << " for writing.\n";
+            std::exit(DbErrorCode::DB_ERROR);
+        }
+    }
+
+    ~BufferedWriter() {
+        flush();
+        if (mOwnsFd) {
+            ::close(mFd);
+        }
     }
 
-    const double get(const int row, const int col); // Fetch the value
-    void put(const int row, const int col, double v); // Store the value
+    void write(const char* data, size_t n);
+    void write(char c);
+    void write(double v);
+    void flush();
 };
 
-inline const double Database::get(const int row, const int col) {
-    // Make key using row and column
-    std::string keyString(std::to_string(row) + std::to_string(col));
+inline void BufferedWriter::write(const char* data, size_t n) {
+    if (mSize + n > mBuffer.size()) {
+        flush();
+    }
+    std::memcpy(mBuffer.data() + mSize, data, n);
+    mSize += n;
+}
 
-    // Conver keyString to char string
-    char* k = new char[keyString.size()];
-    std::memcpy(k, keyString.c_str(), keyString.size());
+inline void BufferedWriter::write(char c) {
+    if (mSize == mBuffer.size()) {
+        flush();
+    }
+    mBuffer[mSize++] = c;
+}
 
-    // Make database key and value
-    Dbt key(static_cast<void*>(k), keyString.size());
-    Dbt value;
+inline void BufferedWriter::write(double v) {
+    // Shortest round-trip representation is at most 24 characters
+    if (mSize + 32 > mBuffer.size()) {
+        flush();
+    }
+    char* end = std::to_chars(mBuffer.data() + mSize, mBuffer.data() + mBuffer.size(), v).ptr;
+    mSize = end - mBuffer.data();
+}
 
-    this->mDatabase->get(nullptr, &key, &value, 0); // Retrieve the value
-    return *static_cast<double*>(value.get_data()); // Return the value
-    // return 0;
+inline void BufferedWriter::flush() {
+    size_t written = 0;
+    while (written < mSize) {
+        ssize_t n = ::write(mFd, mBuffer.data() + written, mSize - written);
+        if (n < 0) {
+            std::cerr << "Error: Write failed.\n";
+            std::exit(DbErrorCode::DB_ERROR);
+        }
+        written += n;
+    }
+    mSize = 0;
 }
 
-inline void Database::put(const int row, const int col, double v) {
-    // Make key using row and column
-    std::string keyString(std::to_string(row) + std::to_string(col));
+// Chunked reader on top of a file descriptor, counterpart of BufferedWriter.
+// Only the unconsumed tail of the current chunk is kept in memory.
+class BufferedReader {
+  private:
+    int mFd;
+    std::vector<char> mBuffer;
+    size_t mBegin; // First unconsumed byte
+    size_t mEnd; // One past last valid byte
 
-    // Conver keyString to char string
-    char* k = new char[keyString.size()];
-    std::memcpy(k, keyString.c_str(), keyString.size());
+  public:
+    BufferedReader(const std::string& path, size_t capacity = 1 << 20)
+        : mFd(-1), mBuffer(capacity), mBegin(0), mEnd(0) {
+        mFd = ::open(path.c_str(), O_RDONLY);
+        if (mFd < 0) {
+            std::cerr << "Error: Unable to open " << path << " for reading.\n";
+            std::exit(DbErrorCode::DB_ERROR);
+        }
+    }
+
+    ~BufferedReader() {
+        ::close(mFd);
+    }
+
+    const char* begin() { return mBuffer.data() + mBegin; }
+    const char* end() { return mBuffer.data() + mEnd; }
+    size_t size() { return mEnd - mBegin; }
+    void consume(size_t n) { mBegin += n; }
 
-    // Make database key and value
-    Dbt key(static_cast<void*>(k), keyString.size());
-    Dbt value(static_cast<void*>(&v), sizeof(v));
+    bool fill();
+    size_t read(char* dst, size_t n);
+};
 
-    this->mDatabase->put(nullptr, &key, &value, 0); // Set/update value
+// Read the next chunk after the unconsumed bytes. Returns false at end of file.
+inline bool BufferedReader::fill() {
+    // Move unconsumed bytes to the front, grow if a single record fills the buffer
+    std::memmove(mBuffer.data(), mBuffer.data() + mBegin, mEnd - mBegin);
+    mEnd -= mBegin;
+    mBegin = 0;
+    if (mEnd == mBuffer.size()) {
+        mBuffer.resize(mBuffer.size() * 2);
+    }
+
+    ssize_t n = ::read(mFd, mBuffer.data() + mEnd, mBuffer.size() - mEnd);
+    if (n < 0) {
+        std::cerr << "Error: Read failed.\n";
+        std::exit(DbErrorCode::DB_ERROR);
+    }
+    mEnd += n;
+    return n > 0;
 }
 
-class Matrix : public Database {
+// Copy up to n bytes into dst, returns number of bytes copied
+inline size_t BufferedReader::read(char* dst, size_t n) {
+    size_t copied = 0;
+    while (copied < n) {
+        if (size() == 0 && !fill()) {
+            break;
+        }
+        size_t len = std::min(n - copied, size());
+        std::memcpy(dst + copied, begin(), len);
+        consume(len);
+        copied += len;
+    }
+    return copied;
+}
+
+// True if path names a raw binary matrix file
+inline bool isBinaryPath(const std::string& path) {
+    return path.size() >= 4 && path.compare(path.size() - 4, 4, ".bin") == 0;
+}
+
+// Write a matrix as text, one row per line, with sep after every cell
+// (trailing) or between cells. M is any matrix with rowCount, colCount
+// and get.
+template <typename M>
+void writeRows(BufferedWriter& out, M& matrix, char sep, bool trailing) {
+    for (int i = 0; i < matrix.rowCount(); ++i) {
+        for (int j = 0; j < matrix.colCount(); ++j) {
+            if (j > 0 && !trailing) {
+                out.write(sep);
+            }
+            out.write(static_cast<double>(matrix.get(i, j)));
+            if (trailing) {
+                out.write(sep);
+            }
+        }
+        out.write('\n');
+    }
+}
+
+// Raw binary matrix: int32 rows, int32 cols, then row-major doubles
+template <typename M>
+void writeBinary(BufferedWriter& out, M& matrix) {
+    int32_t header[2] = {matrix.rowCount(), matrix.colCount()};
+    out.write(reinterpret_cast<const char*>(header), sizeof(header));
+    for (int i = 0; i < matrix.rowCount(); ++i) {
+        for (int j = 0; j < matrix.colCount(); ++j) {
+            double v = matrix.get(i, j);
+            out.write(reinterpret_cast<const char*>(&v), sizeof(v));
+        }
+    }
+}
+
+// Progress of a product, stored in the result database so that an
+// interrupted multiply can resume from the last completed row.
+struct ProductCheckpoint {
+    uint64_t checksum; // Checksum of both inputs
+    int32_t rows;
+    int32_t cols;
+    int32_t inner;
+    int32_t completedRows;
+    double rowSumNorm; // Largest absolute row sum of the completed rows
+};
+
+const std::string PRODUCT_CHECKPOINT_KEY = "__product_checkpoint";
+
+// Base of lazy matrix expressions (see MatrixSum, MatrixProduct, ...)
+template <typename E>
+struct MatrixExpr {
+    const E& self() const { return static_cast<const E&>(*this); }
+};
+
+// Header stored with every matrix, so that it can be reopened without
+// rewriting its cells. Written last, once all cells are stored.
+struct MatrixHeader {
+    uint32_t magic;
+    uint32_t version;
+    int32_t rows;
+    int32_t cols;
+    uint32_t encoding; // Cell value encoding
+    uint32_t layout; // Cell key layout
+};
+
+const std::string MATRIX_HEADER_KEY = "__matrix_header";
+const uint32_t MATRIX_MAGIC = 0x4d545258; // "MTRX"
+const uint32_t MATRIX_VERSION = 1;
+const uint32_t MATRIX_LAYOUT_ROW_COL = 1; // Key is int {row, col}
+const uint32_t MATRIX_LAYOUT_DENSE = 2; // All cells, row-major, in one record
+const std::string MATRIX_CELLS_KEY = "__matrix_cells"; // Record of MATRIX_LAYOUT_DENSE
+
+const int DYNAMIC = -1; // Dimension known only at run time
+
+const size_t IN_FLIGHT_SLOTS = 4096; // Power of two, see Matrix::mInFlight
+
+// Matrix of T cells. With both dimensions DYNAMIC (the default) it is sized
+// at run time and stored cell by cell; with compile-time dimensions it is a
+// small in-memory matrix, see the primary template further down.
+template <typename T = double, int Rows = DYNAMIC, int Cols = DYNAMIC>
+class Matrix;
+
+template <typename T>
+class Matrix<T, DYNAMIC, DYNAMIC> : public Database {
   private:
     int row;
     int col;
     std::string name; // Database name
 
+    // Write-behind: set() queues cells in mPending and returns, the
+    // flusher thread applies them in batches sorted by key
+    struct CellWrite {
+        int row;
+        int col;
+        T value;
+    };
+    MpscRing<CellWrite>* mPending; // nullptr = write through
+    std::thread mFlusher;
+    std::atomic<bool> mStopping;
+    std::atomic<uint64_t> mQueued; // Writes pushed to mPending
+    std::atomic<uint64_t> mApplied; // Writes stored by the flusher
+    // Writes queued and not yet stored, per slot of hashed cells. A get()
+    // only waits for the flusher when its cell's slot has one; empty when
+    // the engine cannot read while the flusher writes, then every get()
+    // waits.
+    std::vector<std::atomic<uint32_t>> mInFlight;
+    double mProductNorm = -1; // Infinity norm of the product stored by multiply(), or -1
+
   public:
-    Matrix(std::string matrixName, int n, int m) : Database(matrixName), row(n), col(m), name(matrixName) {
+    // Open a matrix stored by an earlier run. Only the header is read.
+    Matrix(std::string matrixName, const DatabaseOptions& options = DatabaseOptions())
+        : Database(matrixName, options), row(0), col(0), name(matrixName), mPending(nullptr), mStopping(false),
+          mQueued(0), mApplied(0) {
+        startWriteBehind(options);
+        readHeader();
+    }
+
+    // Load the matrix from a CSV or raw binary (.bin) file
+    Matrix(std::string matrixName, const std::string& path, const DatabaseOptions& options = DatabaseOptions())
+        : Database(matrixName, options), row(0), col(0), name(matrixName), mPending(nullptr), mStopping(false),
+          mQueued(0), mApplied(0) {
+        startWriteBehind(options);
+        std::cout << "Importing matrix from " << path << "...\n";
+        clearHeader();
+        if (isBinaryPath(path)) {
+            importBinary(path);
+        } else {
+            importCsv(path);
+        }
+        writeHeader();
+    }
+
+    Matrix(std::string matrixName, int n, int m, const DatabaseOptions& options = DatabaseOptions())
+        : Database(matrixName, expectRecords(options, static_cast<long long>(n) * m)), row(n), col(m),
+          name(matrixName), mPending(nullptr), mStopping(false), mQueued(0), mApplied(0) {
+        startWriteBehind(options);
+        clearHeader();
         // Initialize the matrix to zero values
         for (int i = 0; i < row; ++i) {
             for (int j = 0; j < col; ++j) {
-                this->Database::put(i, j, 0);
+                this->set(i, j, T());
             }
         }
+        writeHeader();
     }
 
-    Matrix(std::string matrixName, std::vector<std::vector<double>>& matrix)
-            : Database(matrixName), row(matrix.size()), col(matrix[0].size()), name(matrixName) {
-
+    Matrix(std::string matrixName, std::vector<std::vector<double>>& matrix,
+           const DatabaseOptions& options = DatabaseOptions())
+            : Database(matrixName, expectRecords(options, static_cast<long long>(matrix.size()) * matrix[0].size())),
+              row(matrix.size()), col(matrix[0].size()), name(matrixName), mPending(nullptr), mStopping(false),
+              mQueued(0), mApplied(0) {
+        startWriteBehind(options);
+        clearHeader();
         // Initialize the matrix to provided matrix
         for (int i = 0; i < row; ++i) {
             for (int j = 0; j < col; ++j) {
-                this->Database::put(i, j, matrix[i][j]);
+                this->set(i, j, static_cast<T>(matrix[i][j]));
             }
         }
+        writeHeader();
     }
 
-    Matrix(std::string matrixName, Matrix& matrixA, Matrix& matrixB)
-        : Database(matrixName), row(matrixA.rowCount()), col(matrixB.colCount()) {
+    // Initialize the matrix with product of matrix A and B, checkpointing
+    // every checkpointRows rows (0 = only on completion)
+    template <typename TA, typename TB>
+    Matrix(std::string matrixName, Matrix<TA>& matrixA, Matrix<TB>& matrixB, int checkpointRows = 64,
+           const DatabaseOptions& options = DatabaseOptions())
+        : Database(matrixName, expectRecords(options, static_cast<long long>(matrixA.rowCount()) * matrixB.colCount())),
+          row(matrixA.rowCount()), col(matrixB.colCount()), name(matrixName), mPending(nullptr), mStopping(false),
+          mQueued(0), mApplied(0) {
+        startWriteBehind(options);
+        multiply(matrixA, matrixB, checkpointRows);
+    }
 
-        // Initialize the matrix with product of matrix A and B
-        for (int i = 0; i < row; ++i) {
-            for (int j = 0; j < col; ++j) {
-                double res = 0;
-                for (int k = 0; k < matrixB.rowCount(); ++k) {
-                    res += matrixA.get(i, k) * matrixB.get(k, j);
-                }
-                this->set(i, j, res);
-            }
+    ~Matrix() {
+        if (mPending != nullptr) {
+            flush();
+            mStopping = true;
+            mFlusher.join();
+            delete mPending;
         }
     }
 
-    void set(int row, int col, double value) {
-        this->Database::put(row, col, value);
+    void set(int row, int col, T value) {
+        if (mPending == nullptr) {
+            this->Database::put<T>(row, col, value);
+            return;
+        }
+        // A full ring means the flusher is behind; wait for it rather than
+        // write from this thread, so writes keep their order
+        if (!mInFlight.empty()) {
+            ++mInFlight[inFlightSlot(row, col)]; // Before the flusher can store it
+        }
+        while (!mPending->tryPush(CellWrite{row, col, value})) {
+            std::this_thread::yield();
+        }
+        ++mQueued;
     }
 
-    double get(int row, int col) {
-        return this->Database::get(row, col);
+    T get(int row, int col) {
+        if (mPending != nullptr && (mInFlight.empty() || mInFlight[inFlightSlot(row, col)].load() != 0)) {
+            flush(); // Read own writes
+        }
+        return this->Database::get<T>(row, col);
     }
 
+    void flush(); // Wait until every queued set() is stored
+
+    // Infinity norm of this matrix as a product, reduced row by row while
+    // multiply() computed it; -1 if it was not computed by multiply()
+    double productNorm() const { return mProductNorm; }
+
     int rowCount() { return this->row; }
     int colCount() { return this->col; }
+    uint64_t checksum(uint64_t seed = 14695981039346656037ULL);
+    template <typename TA, typename TB>
+    void multiply(Matrix<TA>& matrixA, Matrix<TB>& matrixB, int checkpointRows);
     void print();
+    void exportCsv(const std::string& path);
+    void exportBinary(const std::string& path);
+    void exportTo(const std::string& path);
+    void importCsv(const std::string& path);
+    void importBinary(const std::string& path);
+
+    // Evaluate a lazy expression into this matrix / a new matrix
+    template <typename E>
+    Matrix(std::string matrixName, const MatrixExpr<E>& expr, const DatabaseOptions& options = DatabaseOptions());
+    template <typename E>
+    Matrix& operator=(const MatrixExpr<E>& expr);
+
+  private:
+    void clearHeader();
+    void writeHeader();
+    void readHeader();
+    template <typename E>
+    void assign(const E& expr);
+    void startWriteBehind(const DatabaseOptions& options);
+    void flushPending(); // Flusher thread
+    size_t inFlightSlot(int row, int col) const {
+        return (static_cast<size_t>(row) * 31 + static_cast<size_t>(col)) & (mInFlight.size() - 1);
+    }
+};
+
+// Lazy matrix expressions. Operators on matrices build an expression tree
+// which is only evaluated, one row at a time, when it is assigned to a
+// Matrix or reduced by infinityNorm(). Elementwise operations are applied
+// to each row as the producing kernel emits it, so intermediate results
+// such as A x B in A x B + C are never written to a database.
+//
+// Every node provides rowCount(), colCount() and evalRow(i, out), which
+// writes row i into out[0, colCount()).
+
+// Leaf: a stored matrix. Expressions are evaluated in double, whatever the
+// cell types of their operands.
+template <typename T>
+class MatrixRef : public MatrixExpr<MatrixRef<T>> {
+  private:
+    Matrix<T>* mMatrix;
+
+  public:
+    MatrixRef(Matrix<T>& matrix) : mMatrix(&matrix) {}
+
+    int rowCount() const { return mMatrix->rowCount(); }
+    int colCount() const { return mMatrix->colCount(); }
+
+    void evalRow(int i, double* out) const {
+        for (int j = 0; j < colCount(); ++j) {
+            out[j] = mMatrix->get(i, j);
+        }
+    }
+};
+
+// Elementwise sum (sign = 1) or difference (sign = -1)
+template <typename L, typename R>
+class MatrixSum : public MatrixExpr<MatrixSum<L, R>> {
+  private:
+    L mLeft;
+    R mRight;
+    double mSign;
+
+  public:
+    MatrixSum(const L& left, const R& right, double sign) : mLeft(left), mRight(right), mSign(sign) {}
+
+    int rowCount() const { return mLeft.rowCount(); }
+    int colCount() const { return mLeft.colCount(); }
+
+    void evalRow(int i, double* out) const {
+        std::vector<double> rightRow(colCount());
+        mLeft.evalRow(i, out);
+        mRight.evalRow(i, rightRow.data());
+        for (int j = 0; j < colCount(); ++j) {
+            out[j] += mSign * rightRow[j];
+        }
+    }
+};
+
+// Scalar multiple
+template <typename E>
+class MatrixScaled : public MatrixExpr<MatrixScaled<E>> {
+  private:
+    E mExpr;
+    double mScale;
+
+  public:
+    MatrixScaled(const E& expr, double scale) : mExpr(expr), mScale(scale) {}
+
+    int rowCount() const { return mExpr.rowCount(); }
+    int colCount() const { return mExpr.colCount(); }
+
+    void evalRow(int i, double* out) const {
+        mExpr.evalRow(i, out);
+        for (int j = 0; j < colCount(); ++j) {
+            out[j] *= mScale;
+        }
+    }
 };
 
-inline void Matrix::print() {
+template <typename E>
+struct IsMatrixRef : std::false_type {};
+
+template <typename T>
+struct IsMatrixRef<MatrixRef<T>> : std::true_type {};
+
+// Matrix product. Row i is accumulated as sum over k of L[i][k] * R[k]. A
+// stored right operand is read row by row for every output row; any other
+// right operand is evaluated once, when the product is built, as
+// evaluating it again for every output row would make A x (B x C) O(n^4).
+// Rows are evaluated into local buffers, so evalRow() may be called from
+// several threads at once.
+template <typename L, typename R>
+class MatrixProduct : public MatrixExpr<MatrixProduct<L, R>> {
+  private:
+    L mLeft;
+    R mRight;
+    std::shared_ptr<const std::vector<double>> mRightValues; // Row-major, unless R is a MatrixRef
+
+  public:
+    MatrixProduct(const L& left, const R& right) : mLeft(left), mRight(right) {
+        if (!IsMatrixRef<R>::value) {
+            auto values = std::make_shared<std::vector<double>>(static_cast<size_t>(mRight.rowCount()) * colCount());
+            for (int k = 0; k < mRight.rowCount(); ++k) {
+                mRight.evalRow(k, values->data() + static_cast<size_t>(k) * colCount());
+            }
+            mRightValues = values;
+        }
+    }
+
+    int rowCount() const { return mLeft.rowCount(); }
+    int colCount() const { return mRight.colCount(); }
+
+    void evalRow(int i, double* out) const {
+        std::vector<double> leftRow(mLeft.colCount());
+        std::vector<double> rightRow(mRightValues ? 0 : colCount());
+        mLeft.evalRow(i, leftRow.data());
+        std::fill(out, out + colCount(), 0.0);
+        for (int k = 0; k < mLeft.colCount(); ++k) {
+            const double* row = rightRow.data();
+            if (mRightValues) {
+                row = mRightValues->data() + static_cast<size_t>(k) * colCount();
+            } else {
+                mRight.evalRow(k, rightRow.data());
+            }
+            for (int j = 0; j < colCount(); ++j) {
+                out[j] += leftRow[k] * row[j];
+            }
+        }
+    }
+};
+
+// Operands of expression operators are either a Matrix or an expression
+template <typename T>
+MatrixRef<T> toExpr(Matrix<T>& matrix) { return MatrixRef<T>(matrix); }
+
+template <typename E>
+const E& toExpr(const MatrixExpr<E>& expr) { return expr.self(); }
+
+template <typename T>
+using ExprNode = std::decay_t<decltype(toExpr(std::declval<T&>()))>;
+
+template <typename T>
+struct IsStoredMatrix : std::false_type {};
+
+template <typename T>
+struct IsStoredMatrix<Matrix<T>> : std::true_type {};
+
+template <typename T>
+constexpr bool isMatrixOperand =
+    IsStoredMatrix<std::decay_t<T>>::value || std::is_base_of_v<MatrixExpr<std::decay_t<T>>, std::decay_t<T>>;
+
+template <typename L, typename R, typename = std::enable_if_t<isMatrixOperand<L> && isMatrixOperand<R>>>
+MatrixSum<ExprNode<L>, ExprNode<R>> operator+(L&& left, R&& right) {
+    return MatrixSum<ExprNode<L>, ExprNode<R>>(toExpr(left), toExpr(right), 1.0);
+}
+
+template <typename L, typename R, typename = std::enable_if_t<isMatrixOperand<L> && isMatrixOperand<R>>>
+MatrixSum<ExprNode<L>, ExprNode<R>> operator-(L&& left, R&& right) {
+    return MatrixSum<ExprNode<L>, ExprNode<R>>(toExpr(left), toExpr(right), -1.0);
+}
+
+template <typename L, typename R, typename = std::enable_if_t<isMatrixOperand<L> && isMatrixOperand<R>>>
+MatrixProduct<ExprNode<L>, ExprNode<R>> operator*(L&& left, R&& right) {
+    return MatrixProduct<ExprNode<L>, ExprNode<R>>(toExpr(left), toExpr(right));
+}
+
+template <typename E, typename = std::enable_if_t<isMatrixOperand<E>>>
+MatrixScaled<ExprNode<E>> operator*(double scale, E&& expr) {
+    return MatrixScaled<ExprNode<E>>(toExpr(expr), scale);
+}
+
+// Maximum absolute row sum, computed without storing the expression
+template <typename E, typename = std::enable_if_t<isMatrixOperand<E>>>
+double infinityNorm(E&& operand) {
+    const ExprNode<E>& expr = toExpr(operand);
+    std::vector<double> out(expr.colCount());
+    double infNorm = 0;
+    for (int i = 0; i < expr.rowCount(); ++i) {
+        expr.evalRow(i, out.data());
+        double rowSum = 0;
+        for (double v : out) {
+            rowSum += std::abs(v);
+        }
+        infNorm = std::max(infNorm, rowSum);
+    }
+
+    return infNorm;
+}
+
+template <typename T>
+template <typename E>
+Matrix<T, DYNAMIC, DYNAMIC>::Matrix(std::string matrixName, const MatrixExpr<E>& expr, const DatabaseOptions& options)
+    : Database(matrixName,
+               expectRecords(options, static_cast<long long>(expr.self().rowCount()) * expr.self().colCount())),
+      row(expr.self().rowCount()), col(expr.self().colCount()), name(matrixName), mPending(nullptr), mStopping(false),
+      mQueued(0), mApplied(0) {
+    startWriteBehind(options);
+    assign(expr.self());
+}
+
+// Note: the right operand of a product must not be this matrix, as its
+// rows are re-read after earlier rows of the result have been stored.
+template <typename T>
+template <typename E>
+Matrix<T, DYNAMIC, DYNAMIC>& Matrix<T, DYNAMIC, DYNAMIC>::operator=(const MatrixExpr<E>& expr) {
+    if (expr.self().rowCount() != this->row || expr.self().colCount() != this->col) {
+        std::cerr << "Error: Cannot assign " << expr.self().rowCount() << "x" << expr.self().colCount()
+                  << " expression to " << this->row << "x" << this->col << " matrix " << this->name << ".\n";
+        std::exit(DbErrorCode::DB_ERROR);
+    }
+    assign(expr.self());
+    return *this;
+}
+
+template <typename T>
+template <typename E>
+void Matrix<T, DYNAMIC, DYNAMIC>::assign(const E& expr) {
+    clearHeader();
+    std::vector<double> out(this->col);
     for (int i = 0; i < this->row; ++i) {
+        expr.evalRow(i, out.data());
+        for (int j = 0; j < this->col; ++j) {
+            this->set(i, j, static_cast<T>(out[j]));
+        }
+    }
+    writeHeader();
+}
+
+// FNV-1a checksum of all values in row-major order
+template <typename T>
+inline uint64_t Matrix<T, DYNAMIC, DYNAMIC>::checksum(uint64_t seed) {
+    uint64_t hash = seed;
+    for (int i = 0; i < this->row; ++i) {
+        for (int j = 0; j < this->col; ++j) {
+            T v = this->get(i, j);
+            const unsigned char* bytes = reinterpret_cast<const unsigned char*>(&v);
+            for (size_t b = 0; b < sizeof(v); ++b) {
+                hash = (hash ^ bytes[b]) * 1099511628211ULL;
+            }
+        }
+    }
+
+    return hash;
+}
+
+// Compute A x B into this matrix one row at a time. A checkpoint record is
+// written after every checkpointRows rows; rerunning with the same inputs
+// resumes after the last checkpoint instead of starting over.
+template <typename T>
+template <typename TA, typename TB>
+inline void Matrix<T, DYNAMIC, DYNAMIC>::multiply(Matrix<TA>& matrixA, Matrix<TB>& matrixB, int checkpointRows) {
+    ProductCheckpoint progress = {};
+    progress.checksum = matrixB.checksum(matrixA.checksum());
+    progress.rows = this->row;
+    progress.cols = this->col;
+    progress.inner = matrixB.rowCount();
+
+    int first = 0; // First row still to compute
+    ProductCheckpoint saved;
+    if (getRecord(PRODUCT_CHECKPOINT_KEY, &saved, sizeof(saved)) && saved.checksum == progress.checksum &&
+        saved.rows == progress.rows && saved.cols == progress.cols && saved.inner == progress.inner) {
+        first = saved.completedRows;
+        progress.rowSumNorm = saved.rowSumNorm;
+        if (first == this->row) {
+            std::cout << "Product " << this->name << " already computed, skipping multiply...\n";
+            mProductNorm = saved.rowSumNorm;
+            writeHeader();
+            return;
+        }
+        std::cout << "Resuming product " << this->name << " from row " << first << " of " << this->row << "...\n";
+    }
+
+    clearHeader();
+    for (int i = first; i < this->row; ++i) {
+        double rowSum = 0;
         for (int j = 0; j < this->col; ++j) {
-            std::cout << this->get(i, j) << ' ';
+            decltype(TA() * TB()) res = 0; // Promoted, so narrow cells do not overflow
+            for (int k = 0; k < matrixB.rowCount(); ++k) {
+                res += matrixA.get(i, k) * matrixB.get(k, j);
+            }
+            this->set(i, j, static_cast<T>(res));
+            rowSum += std::abs(static_cast<double>(static_cast<T>(res)));
+        }
+        progress.rowSumNorm = std::max(progress.rowSumNorm, rowSum); // Norm without a second pass over C
+
+        if ((checkpointRows > 0 && (i + 1 - first) % checkpointRows == 0) || i + 1 == this->row) {
+            flush();
+            this->sync(); // Rows must reach disk before the record that covers them
+            progress.completedRows = i + 1;
+            putRecord(PRODUCT_CHECKPOINT_KEY, &progress, sizeof(progress));
+            this->sync();
+        }
+    }
+    mProductNorm = progress.rowSumNorm;
+    writeHeader();
+}
+
+template <typename T>
+inline void Matrix<T, DYNAMIC, DYNAMIC>::startWriteBehind(const DatabaseOptions& options) {
+    if (options.writeBehind > 0) {
+        if (options.engine == StorageEngine::BDB) {
+            mInFlight = std::vector<std::atomic<uint32_t>>(IN_FLIGHT_SLOTS); // Free-threaded handles
         }
-        std::cout << std::endl;
+        mPending = new MpscRing<CellWrite>(options.writeBehind);
+        mFlusher = std::thread(&Matrix::flushPending, this);
+    }
+}
+
+template <typename T>
+inline void Matrix<T, DYNAMIC, DYNAMIC>::flush() {
+    while (mPending != nullptr && mApplied.load() != mQueued.load()) {
+        std::this_thread::yield();
     }
 }
 
+// Drain the ring in batches of up to its capacity. A stable sort by key
+// keeps the order of writes to the same cell, so the last one wins.
+template <typename T>
+void Matrix<T, DYNAMIC, DYNAMIC>::flushPending() {
+    std::vector<CellWrite> batch;
+    batch.reserve(mPending->capacity());
+    for (;;) {
+        CellWrite write;
+        while (batch.size() < mPending->capacity() && mPending->tryPop(write)) {
+            batch.push_back(write);
+        }
+        if (batch.empty()) {
+            if (mStopping) {
+                return;
+            }
+            std::this_thread::sleep_for(std::chrono::microseconds(50)); // Idle
+            continue;
+        }
+
+        std::stable_sort(batch.begin(), batch.end(), [](const CellWrite& a, const CellWrite& b) {
+            return a.row != b.row ? a.row < b.row : a.col < b.col;
+        });
+        for (const CellWrite& w : batch) {
+            this->Database::put<T>(w.row, w.col, w.value);
+            if (!mInFlight.empty()) {
+                --mInFlight[inFlightSlot(w.row, w.col)];
+            }
+        }
+        mApplied += batch.size();
+        batch.clear();
+    }
+}
+
+// Header is removed while cells are (re)written, so an interrupted
+// initialization cannot be reopened as a complete matrix
+template <typename T>
+inline void Matrix<T, DYNAMIC, DYNAMIC>::clearHeader() {
+    flush(); // Flusher and caller never use the handle at once
+    removeRecord(MATRIX_HEADER_KEY);
+}
+
+template <typename T>
+inline void Matrix<T, DYNAMIC, DYNAMIC>::writeHeader() {
+    flush(); // Cells first
+    MatrixHeader header = {MATRIX_MAGIC, MATRIX_VERSION, this->row, this->col, CellCodec<T>::ENCODING,
+                           MATRIX_LAYOUT_ROW_COL};
+    putRecord(MATRIX_HEADER_KEY, &header, sizeof(header));
+    sync();
+}
+
+template <typename T>
+inline void Matrix<T, DYNAMIC, DYNAMIC>::readHeader() {
+    MatrixHeader header;
+    if (!getRecord(MATRIX_HEADER_KEY, &header, sizeof(header)) || header.magic != MATRIX_MAGIC) {
+        std::cerr << "Error: No complete matrix stored in database " << this->name << ".\n";
+        std::exit(DbErrorCode::DB_ERROR);
+    }
+    if (header.version != MATRIX_VERSION || header.encoding != CellCodec<T>::ENCODING ||
+        header.layout != MATRIX_LAYOUT_ROW_COL) {
+        std::cerr << "Error: Matrix " << this->name << " has unsupported format (version " << header.version
+                  << ", encoding " << header.encoding << ", layout " << header.layout << ").\n";
+        std::exit(DbErrorCode::DB_ERROR);
+    }
+
+    this->row = header.rows;
+    this->col = header.cols;
+    std::cout << "Opened " << this->row << "x" << this->col << " matrix " << this->name << ".\n";
+}
+
+template <typename T>
+inline void Matrix<T, DYNAMIC, DYNAMIC>::print() {
+    std::cout.flush(); // Keep ordering with earlier std::cout output
+    BufferedWriter out(STDOUT_FILENO);
+    writeRows(out, *this, ' ', true);
+}
+
+// Export matrix as CSV, one row per line
+template <typename T>
+inline void Matrix<T, DYNAMIC, DYNAMIC>::exportCsv(const std::string& path) {
+    BufferedWriter out(path);
+    writeRows(out, *this, ',', false);
+}
+
+// Export matrix as raw binary: int32 rows, int32 cols, then row-major doubles
+template <typename T>
+inline void Matrix<T, DYNAMIC, DYNAMIC>::exportBinary(const std::string& path) {
+    BufferedWriter out(path);
+    writeBinary(out, *this);
+}
+
+// Export matrix, picking the format from the file extension (.bin or CSV)
+template <typename T>
+inline void Matrix<T, DYNAMIC, DYNAMIC>::exportTo(const std::string& path) {
+    std::cout << "Exporting matrix to " << path << "...\n";
+    if (isBinaryPath(path)) {
+        exportBinary(path);
+    } else {
+        exportCsv(path);
+    }
+}
+
+// Import matrix from CSV, one row per line. Rows are parsed and stored
+// as each chunk arrives so the file is never held in memory.
+template <typename T>
+inline void Matrix<T, DYNAMIC, DYNAMIC>::importCsv(const std::string& path) {
+    BufferedReader in(path);
+    this->row = 0;
+    this->col = 0;
+
+    bool more = true;
+    while (more || in.size() > 0) {
+        const char* first = in.begin();
+        const char* last = static_cast<const char*>(std::memchr(first, '\n', in.size()));
+        if (last == nullptr) {
+            if ((more = in.fill())) {
+                continue; // Line continues in next chunk
+            }
+            last = in.end(); // Last line without newline
+            first = in.begin();
+        }
+
+        int j = 0;
+        const char* p = first;
+        while (p < last) {
+            while (p < last && (*p == ' ' || *p == '\t' || *p == '\r')) {
+                ++p;
+            }
+            if (p == last) {
+                break;
+            }
+
+            double value;
+            std::from_chars_result res = std::from_chars(p, last, value);
+            if (res.ec != std::errc()) {
+                std::cerr << "Error: Invalid number in " << path << " at row " << this->row + 1 << ".\n";
+                std::exit(DbErrorCode::DB_ERROR);
+            }
+            this->set(this->row, j++, static_cast<T>(value));
+
+            p = res.ptr;
+            while (p < last && (*p == ' ' || *p == '\t' || *p == '\r')) {
+                ++p;
+            }
+            if (p < last && *p == ',') {
+                ++p;
+            }
+        }
+        in.consume(last - first + (last < in.end() ? 1 : 0));
+
+        if (j == 0) {
+            continue; // Skip empty lines
+        }
+        if (this->row == 0) {
+            this->col = j;
+        } else if (j != this->col) {
+            std::cerr << "Error: Row " << this->row + 1 << " of " << path << " has " << j << " columns, expected "
+                      << this->col << ".\n";
+            std::exit(DbErrorCode::DB_ERROR);
+        }
+        ++this->row;
+    }
+}
+
+// Import matrix written by exportBinary()
+template <typename T>
+inline void Matrix<T, DYNAMIC, DYNAMIC>::importBinary(const std::string& path) {
+    BufferedReader in(path);
+    int32_t header[2];
+    if (in.read(reinterpret_cast<char*>(header), sizeof(header)) != sizeof(header) || header[0] < 0 || header[1] < 0) {
+        std::cerr << "Error: Invalid matrix header in " << path << ".\n";
+        std::exit(DbErrorCode::DB_ERROR);
+    }
+    this->row = header[0];
+    this->col = header[1];
+
+    for (int i = 0; i < this->row; ++i) {
+        for (int j = 0; j < this->col; ++j) {
+            double v;
+            if (in.read(reinterpret_cast<char*>(&v), sizeof(v)) != sizeof(v)) {
+                std::cerr << "Error: Unexpected end of " << path << ".\n";
+                std::exit(DbErrorCode::DB_ERROR);
+            }
+            this->set(i, j, static_cast<T>(v));
+        }
+    }
+}
+
+// Matrix with dimensions fixed at compile time, meant for small matrices.
+// Cells are held in memory and stored as one record, and the kernels
+// below are unrolled at compile time, so it never takes the per-cell
+// database path of the runtime-sized Matrix.
+template <typename T, int Rows, int Cols>
+class Matrix : public Database {
+    static_assert(Rows > 0 && Cols > 0, "Fixed dimensions must be positive, use DYNAMIC for both otherwise");
+
+  public:
+    using Cells = std::array<T, Rows * Cols>; // Row-major
+
+  private:
+    Cells mCells;
+    std::string name; // Database name
+
+  public:
+    // Open a matrix stored by an earlier run
+    Matrix(std::string matrixName, const DatabaseOptions& options = DatabaseOptions())
+        : Database(matrixName, options), mCells(), name(matrixName) {
+        load();
+    }
+
+    Matrix(std::string matrixName, const Cells& cells, const DatabaseOptions& options = DatabaseOptions())
+        : Database(matrixName, expectRecords(options, 0)), mCells(cells), name(matrixName) {
+        store();
+    }
+
+    static constexpr int rowCount() { return Rows; }
+    static constexpr int colCount() { return Cols; }
+    const Cells& cells() const { return mCells; }
+    T get(int row, int col) const { return mCells[row * Cols + col]; }
+    void print();
+    void exportTo(const std::string& path);
+
+  private:
+    void load();
+    void store();
+};
+
+// Header is written after the cells, as for runtime-sized matrices
+template <typename T, int Rows, int Cols>
+inline void Matrix<T, Rows, Cols>::store() {
+    removeRecord(MATRIX_HEADER_KEY);
+    char data[Rows * Cols * CellCodec<T>::SIZE];
+    for (size_t c = 0; c < mCells.size(); ++c) {
+        CellCodec<T>::encode(mCells[c], data + c * CellCodec<T>::SIZE);
+    }
+    putRecord(MATRIX_CELLS_KEY, data, sizeof(data));
+
+    MatrixHeader header = {MATRIX_MAGIC, MATRIX_VERSION, Rows, Cols, CellCodec<T>::ENCODING, MATRIX_LAYOUT_DENSE};
+    putRecord(MATRIX_HEADER_KEY, &header, sizeof(header));
+    sync();
+}
+
+template <typename T, int Rows, int Cols>
+inline void Matrix<T, Rows, Cols>::load() {
+    MatrixHeader header;
+    if (!getRecord(MATRIX_HEADER_KEY, &header, sizeof(header)) || header.magic != MATRIX_MAGIC) {
+        std::cerr << "Error: No complete matrix stored in database " << this->name << ".\n";
+        std::exit(DbErrorCode::DB_ERROR);
+    }
+    if (header.version != MATRIX_VERSION || header.encoding != CellCodec<T>::ENCODING ||
+        header.layout != MATRIX_LAYOUT_DENSE || header.rows != Rows || header.cols != Cols) {
+        std::cerr << "Error: Matrix " << this->name << " is not a " << Rows << "x" << Cols << " dense matrix of "
+                  << "encoding " << CellCodec<T>::ENCODING << ".\n";
+        std::exit(DbErrorCode::DB_ERROR);
+    }
+
+    char data[Rows * Cols * CellCodec<T>::SIZE];
+    if (!getRecord(MATRIX_CELLS_KEY, data, sizeof(data))) {
+        std::cerr << "Error: Cells of matrix " << this->name << " are missing.\n";
+        std::exit(DbErrorCode::DB_ERROR);
+    }
+    for (size_t c = 0; c < mCells.size(); ++c) {
+        mCells[c] = CellCodec<T>::decode(data + c * CellCodec<T>::SIZE);
+    }
+    std::cout << "Opened " << Rows << "x" << Cols << " matrix " << this->name << ".\n";
+}
+
+template <typename T, int Rows, int Cols>
+inline void Matrix<T, Rows, Cols>::print() {
+    std::cout.flush(); // Keep ordering with earlier std::cout output
+    BufferedWriter out(STDOUT_FILENO);
+    writeRows(out, *this, ' ', true);
+}
+
+template <typename T, int Rows, int Cols>
+inline void Matrix<T, Rows, Cols>::exportTo(const std::string& path) {
+    std::cout << "Exporting matrix to " << path << "...\n";
+    BufferedWriter out(path);
+    if (isBinaryPath(path)) {
+        writeBinary(out, *this);
+    } else {
+        writeRows(out, *this, ',', false);
+    }
+}
+
+// Compile-time kernels of fixed-size matrices. Every loop is expanded from
+// an index sequence, so a 16x16 product is straight-line code.
+template <typename R, int K, int M, typename A, typename B, size_t... k>
+constexpr R fixedDot(const A& a, const B& b, int i, int j, std::index_sequence<k...>) {
+    return (R(0) + ... + (R(a[i * K + k]) * R(b[k * M + j])));
+}
+
+template <int N, int K, int M, typename TA, typename TB, size_t... c>
+constexpr auto fixedProduct(const std::array<TA, N * K>& a, const std::array<TB, K * M>& b,
+                            std::index_sequence<c...>) {
+    using R = decltype(TA() * TB());
+    return std::array<R, N * M>{{fixedDot<R, K, M>(a, b, c / M, c % M, std::make_index_sequence<K>())...}};
+}
+
+// N x K times K x M cells, accumulated in the promoted cell type
+template <int N, int K, int M, typename TA, typename TB>
+constexpr auto fixedProduct(const std::array<TA, N * K>& a, const std::array<TB, K * M>& b) {
+    return fixedProduct<N, K, M>(a, b, std::make_index_sequence<N * M>());
+}
+
+template <int N, int M, typename T, size_t... j>
+constexpr double fixedRowSum(const std::array<T, N * M>& a, int i, std::index_sequence<j...>) {
+    return (0.0 + ... + (a[i * M + j] < 0 ? -double(a[i * M + j]) : double(a[i * M + j])));
+}
+
+template <int N, int M, typename T, size_t... i>
+constexpr double fixedInfinityNorm(const std::array<T, N * M>& a, std::index_sequence<i...>) {
+    return std::max({fixedRowSum<N, M>(a, i, std::make_index_sequence<M>())...});
+}
+
+// Maximum absolute row sum of N x M cells
+template <int N, int M, typename T>
+constexpr double fixedInfinityNorm(const std::array<T, N * M>& a) {
+    return fixedInfinityNorm<N, M>(a, std::make_index_sequence<N>());
+}
+
 // Fill matrix with random numbers
 void fillMatrix(const std::vector<std::vector<double>>& matrix) {
     for (const std::vector<double>& mat : matrix) {
@@ -178,62 +1231,591 @@ void printElapsedTime(const timeval& t1, const timeval& t2) {
     std::cout << std::abs(t2.tv_sec - t1.tv_sec) << "s " << std::abs(t2.tv_usec - t1.tv_usec) / 1000 << "ms";
 }
 
-int main(const int argc, const char* argv[]) {
-    if (argc < 6) {
-        std::cerr << "Usage: " << argv[0] << " database_name <Matrix A row col> <Matrix B row col>" << std::endl;
-        std::exit(1);
+void printTotalTime(const timeval& start) {
+    timeval elapsed;
+    gettimeofday(&elapsed, nullptr);
+
+    // Total elapsed time
+    std::cout << "\nTotal time taken: ";
+    printElapsedTime(start, elapsed); // Print elapsed
+    std::cout << ".\n";
+}
+
+// Dimensions of script.sh, served by compile-time matrices
+const int FIXED_SIZE = 16;
+
+// Multiply random N x K and K x M matrices with compile-time dimensions.
+// Random cells are below 100, so A and B are stored as bytes.
+template <int N, int K, int M>
+void multiplyFixed(const std::string& name, const std::vector<std::vector<double>>& A,
+                   const std::vector<std::vector<double>>& B, const DatabaseOptions& options,
+                   const std::string& exportPath, PhaseProfiler& profiler) {
+    profiler.phase("load");
+    typename Matrix<uint8_t, N, K>::Cells a;
+    typename Matrix<uint8_t, K, M>::Cells b;
+    for (int i = 0; i < N; ++i) {
+        for (int j = 0; j < K; ++j) {
+            a[i * K + j] = static_cast<uint8_t>(A[i][j]);
+        }
+    }
+    for (int i = 0; i < K; ++i) {
+        for (int j = 0; j < M; ++j) {
+            b[i * M + j] = static_cast<uint8_t>(B[i][j]);
+        }
     }
 
-    std::string database_name = argv[1];
+    Matrix<uint8_t, N, K> ma(name + "_a", a, options);
+    Matrix<uint8_t, K, M> mb(name + "_b", b, options);
+    profiler.phase("multiply");
+    Matrix<int32_t, N, M> mc(name + "_c", fixedProduct<N, K, M>(ma.cells(), mb.cells()), options);
 
-    if (std::stoi(argv[3]) != std::stoi(argv[4])) {
-        std::cerr << "Cannot multiply matrix A and B" << std::endl;
-        exit(1);
+    // Print matrices
+    profiler.phase("print");
+    std::cout << "\nMatrix A:" << std::endl;
+    ma.print();
+    std::cout << "\nMatrix B:" << std::endl;
+    mb.print();
+    std::cout << "\nMatrix A x B:" << std::endl;
+    mc.print();
+    profiler.phase("norm");
+    std::cout << "\nInfinity Norm of A x B: " << fixedInfinityNorm<N, M>(mc.cells()) << std::endl;
+    std::cout << std::endl;
+
+    profiler.phase("report"); // Page statistics and export
+    ma.printPageReport();
+    mb.printPageReport();
+    mc.printPageReport();
+    std::cout << std::endl;
+
+    if (!exportPath.empty()) {
+        mc.exportTo(exportPath); // Export A x B as CSV, or raw binary for .bin
     }
+    profiler.phase("close"); // Matrices close as they go out of scope
+}
+
+// Distributed multiply: a grid x grid mesh of worker processes, standing
+// in for nodes, each owning tile (r, c) of A, B and C in an environment
+// of its own. SUMMA schedule: in step s the owners of A(r, s) broadcast
+// it along their grid row and the owners of B(s, c) along their grid
+// column, and every worker adds A(r, s) x B(s, c) to its C tile. Tiles
+// travel over socket pairs between workers sharing a row or column.
+struct SummaConfig {
+    std::string name; // Prefix of the worker environments
+    int grid; // Workers per grid row and column
+    int n; // A is n x k, B is k x m
+    int k;
+    int m;
+    unsigned seed; // Cell values are a function of seed and position
+};
 
-    int n = std::stoi(argv[2]);
-    int k = std::stoi(argv[3]);
-    int m = std::stoi(argv[5]);
+struct SummaTimes {
+    double compute = 0; // Milliseconds multiplying tiles
+    double communication = 0; // Waiting for tiles and for peers to take ours
+    double io = 0; // Reading A and B tiles from, and writing C to, the database
+    long long bytesSent = 0;
+};
 
-    // Matrix of vectors
-    std::vector<std::vector<double>> A(n, std::vector<double>(k, 0.0));
-    std::vector<std::vector<double>> B(k, std::vector<double>(m, 0.0));
+// Cell (i, j) of operand matrix (0 = A, 1 = B), below 100 as from fillMatrix()
+inline double summaCell(unsigned seed, int matrix, int i, int j) {
+    uint64_t h = (uint64_t(seed) << 32) ^ (uint64_t(matrix) << 62) ^ (uint64_t(uint32_t(i)) << 31) ^ uint32_t(j);
+    h = (h ^ (h >> 30)) * 0xbf58476d1ce4e5b9ULL; // splitmix64 finalizer
+    h = (h ^ (h >> 27)) * 0x94d049bb133111ebULL;
+    return (h ^ (h >> 31)) % 100;
+}
 
-    // Fill matrix with random values
-    std::srand(std::time(nullptr));
-    fillMatrix(A);
-    fillMatrix(B);
+// First index of block b when size is split into blocks parts
+inline int blockStart(int size, int blocks, int b) {
+    return static_cast<long long>(size) * b / blocks;
+}
+
+inline double millisecondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Write all size bytes; pipes and sockets may take fewer per call. False
+// on error.
+bool writeAll(int fd, const void* data, size_t size) {
+    const char* bytes = static_cast<const char*>(data);
+    for (size_t sent = 0; sent < size;) {
+        ssize_t n = ::write(fd, bytes + sent, size - sent);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        sent += n;
+    }
+    return true;
+}
+
+// Read exactly size bytes. False on error or end of file.
+bool readAll(int fd, void* data, size_t size) {
+    char* bytes = static_cast<char*>(data);
+    for (size_t received = 0; received < size;) {
+        ssize_t n = ::read(fd, bytes + received, size - received);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        received += n;
+    }
+    return true;
+}
+
+void sendTile(int fd, const std::vector<double>& tile) {
+    if (!writeAll(fd, tile.data(), tile.size() * sizeof(double))) {
+        std::cerr << "Error: Unable to send tile.\n";
+        _exit(DbErrorCode::DB_ERROR);
+    }
+}
+
+void receiveTile(int fd, std::vector<double>& tile) {
+    if (!readAll(fd, tile.data(), tile.size() * sizeof(double))) {
+        std::cerr << "Error: Unable to receive tile.\n";
+        _exit(DbErrorCode::DB_ERROR);
+    }
+}
+
+// Cells of a stored matrix, row-major
+std::vector<double> readTile(Matrix<>& matrix) {
+    std::vector<double> tile(static_cast<size_t>(matrix.rowCount()) * matrix.colCount());
+    for (int i = 0; i < matrix.rowCount(); ++i) {
+        for (int j = 0; j < matrix.colCount(); ++j) {
+            tile[static_cast<size_t>(i) * matrix.colCount() + j] = matrix.get(i, j);
+        }
+    }
+    return tile;
+}
+
+// Run in worker process (r, c): store its A and B tiles, run the SUMMA
+// steps, store its C tile and report times and C's absolute row sums
+// through reportFd. links[w] is the socket to worker w, or -1.
+void runSummaWorker(const SummaConfig& config, int r, int c, const std::vector<int>& links, int reportFd,
+                    DatabaseOptions options) {
+    std::cout.setstate(std::ios::failbit); // Keep open/close messages of workers quiet
+    const int g = config.grid;
+    options.home = "./db/" + config.name + "_worker_" + std::to_string(r) + "_" + std::to_string(c);
+    mkdir(options.home.c_str(), 0755);
+
+    // Tile (r, c) spans these rows/columns of the n x k, k x m and n x m matrices
+    auto rows = [&](int b) { return blockStart(config.n, g, b + 1) - blockStart(config.n, g, b); };
+    auto inner = [&](int b) { return blockStart(config.k, g, b + 1) - blockStart(config.k, g, b); };
+    auto cols = [&](int b) { return blockStart(config.m, g, b + 1) - blockStart(config.m, g, b); };
+
+    // Each node owns and stores its partition of the operands
+    std::vector<std::vector<double>> a(rows(r), std::vector<double>(inner(c)));
+    for (int i = 0; i < rows(r); ++i) {
+        for (int j = 0; j < inner(c); ++j) {
+            a[i][j] = summaCell(config.seed, 0, blockStart(config.n, g, r) + i, blockStart(config.k, g, c) + j);
+        }
+    }
+    std::vector<std::vector<double>> b(inner(r), std::vector<double>(cols(c)));
+    for (int i = 0; i < inner(r); ++i) {
+        for (int j = 0; j < cols(c); ++j) {
+            b[i][j] = summaCell(config.seed, 1, blockStart(config.k, g, r) + i, blockStart(config.m, g, c) + j);
+        }
+    }
+    Matrix<>* ma = a.empty() || a[0].empty() ? nullptr : new Matrix<>("a", a, options);
+    Matrix<>* mb = b.empty() || b[0].empty() ? nullptr : new Matrix<>("b", b, options);
+
+    SummaTimes times;
+    std::vector<double> tileC(static_cast<size_t>(rows(r)) * cols(c), 0.0);
+    std::vector<double> tileA;
+    std::vector<double> tileB;
+    for (int s = 0; s < g; ++s) {
+        tileA.assign(static_cast<size_t>(rows(r)) * inner(s), 0.0);
+        tileB.assign(static_cast<size_t>(inner(s)) * cols(c), 0.0);
+
+        auto start = std::chrono::steady_clock::now();
+        if (c == s && ma != nullptr) {
+            tileA = readTile(*ma);
+        }
+        if (r == s && mb != nullptr) {
+            tileB = readTile(*mb);
+        }
+        times.io += millisecondsSince(start);
+
+        // Broadcast from a thread of its own, so that no two workers can
+        // block on each other's full socket buffers
+        start = std::chrono::steady_clock::now();
+        std::thread sender([&]() {
+            for (int p = 0; p < g; ++p) {
+                if (c == s && p != c) {
+                    sendTile(links[r * g + p], tileA); // Along grid row r
+                    times.bytesSent += tileA.size() * sizeof(double);
+                }
+                if (r == s && p != r) {
+                    sendTile(links[p * g + c], tileB); // Along grid column c
+                    times.bytesSent += tileB.size() * sizeof(double);
+                }
+            }
+        });
+        if (c != s) {
+            receiveTile(links[r * g + s], tileA);
+        }
+        if (r != s) {
+            receiveTile(links[s * g + c], tileB);
+        }
+        sender.join();
+        times.communication += millisecondsSince(start);
+
+        start = std::chrono::steady_clock::now();
+        const int kk = inner(s);
+        const int mm = cols(c);
+        for (int i = 0; i < rows(r); ++i) {
+            for (int x = 0; x < kk; ++x) {
+                const double av = tileA[static_cast<size_t>(i) * kk + x];
+                const double* bRow = &tileB[static_cast<size_t>(x) * mm];
+                double* cRow = &tileC[static_cast<size_t>(i) * mm];
+                for (int j = 0; j < mm; ++j) {
+                    cRow[j] += av * bRow[j];
+                }
+            }
+        }
+        times.compute += millisecondsSince(start);
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<double> rowSums(rows(r), 0.0);
+    if (!tileC.empty()) {
+        std::vector<std::vector<double>> cells(rows(r), std::vector<double>(cols(c)));
+        for (int i = 0; i < rows(r); ++i) {
+            for (int j = 0; j < cols(c); ++j) {
+                cells[i][j] = tileC[static_cast<size_t>(i) * cols(c) + j];
+                rowSums[i] += std::abs(cells[i][j]);
+            }
+        }
+        Matrix<>* mc = new Matrix<>("c", cells, options); // Stored with its header
+        delete mc;
+    }
+    times.io += millisecondsSince(start);
+
+    delete ma;
+    delete mb;
+    // Row sums of a large tile exceed PIPE_BUF, so the report may take
+    // several writes
+    if (!writeAll(reportFd, &times, sizeof(times)) ||
+        !writeAll(reportFd, rowSums.data(), rowSums.size() * sizeof(double))) {
+        std::cerr << "Error: Unable to report to the coordinator.\n";
+        _exit(DbErrorCode::DB_ERROR);
+    }
+}
+
+// Coordinator: start the grid of workers, wait for their reports and
+// print per-worker times and the infinity norm of A x B. With verify, the
+// norm is checked against a product computed in this process.
+void multiplySumma(const SummaConfig& config, const DatabaseOptions& options, bool verify) {
+    const int g = config.grid;
+    const int workers = g * g;
+
+    // Socket pair between every two workers of a grid row or column
+    std::vector<std::vector<int>> links(workers, std::vector<int>(workers, -1));
+    for (int w = 0; w < workers; ++w) {
+        for (int v = w + 1; v < workers; ++v) {
+            if (w / g != v / g && w % g != v % g) {
+                continue;
+            }
+            int pair[2];
+            if (socketpair(AF_UNIX, SOCK_STREAM, 0, pair) != 0) {
+                std::cerr << "Error: Unable to create socket pair.\n";
+                std::exit(DbErrorCode::DB_ERROR);
+            }
+            links[w][v] = pair[0];
+            links[v][w] = pair[1];
+        }
+    }
+
+    std::cout << "Multiplying " << config.n << "x" << config.k << " by " << config.k << "x" << config.m << " on "
+              << g << "x" << g << " workers..." << std::endl;
+    std::vector<int> reports;
+    std::vector<pid_t> children;
+    for (int w = 0; w < workers; ++w) {
+        int pipeFds[2];
+        if (pipe(pipeFds) != 0) {
+            std::cerr << "Error: Unable to create pipe.\n";
+            std::exit(DbErrorCode::DB_ERROR);
+        }
+
+        std::cout.flush(); // Nothing buffered may be written twice
+        pid_t pid = fork();
+        if (pid < 0) {
+            std::cerr << "Error: Unable to fork.\n";
+            std::exit(DbErrorCode::DB_ERROR);
+        }
+        if (pid == 0) {
+            ::close(pipeFds[0]);
+            for (int v = 0; v < workers; ++v) {
+                for (int u = 0; u < workers; ++u) {
+                    if (v != w && links[v][u] >= 0) {
+                        ::close(links[v][u]); // Ends of other workers
+                    }
+                }
+            }
+            runSummaWorker(config, w / g, w % g, links[w], pipeFds[1], options);
+            _exit(0);
+        }
+        ::close(pipeFds[1]);
+        reports.push_back(pipeFds[0]);
+        children.push_back(pid);
+    }
+    for (const std::vector<int>& row : links) {
+        for (int fd : row) {
+            if (fd >= 0) {
+                ::close(fd);
+            }
+        }
+    }
+
+    std::vector<double> rowSums(config.n, 0.0);
+    std::cout << "\nWorker\tTile\t\tCompute(ms)\tCommunication(ms)\tI/O(ms)\tSent(KB)\n";
+    for (int w = 0; w < workers; ++w) {
+        const int r = w / g;
+        const int c = w % g;
+        const int firstRow = blockStart(config.n, g, r);
+        const int rowCount = blockStart(config.n, g, r + 1) - firstRow;
+        SummaTimes times;
+        std::vector<double> sums(rowCount);
+        if (!readAll(reports[w], &times, sizeof(times)) ||
+            !readAll(reports[w], sums.data(), sums.size() * sizeof(double))) {
+            std::cerr << "Error: Worker " << w << " failed.\n";
+            std::exit(DbErrorCode::DB_ERROR);
+        }
+        ::close(reports[w]);
+        waitpid(children[w], nullptr, 0);
+
+        for (int i = 0; i < rowCount; ++i) {
+            rowSums[firstRow + i] += sums[i];
+        }
+        std::cout << "(" << r << ", " << c << ")\t" << rowCount << "x"
+                  << blockStart(config.m, g, c + 1) - blockStart(config.m, g, c) << "\t\t" << times.compute
+                  << "\t\t" << times.communication << "\t\t\t" << times.io << "\t" << times.bytesSent / 1024
+                  << '\n';
+    }
+
+    double norm = 0;
+    for (double sum : rowSums) {
+        norm = std::max(norm, sum);
+    }
+    std::cout << "\nInfinity Norm of A x B: " << norm << std::endl;
+
+    if (verify) {
+        double expected = 0;
+        std::vector<double> row(config.m);
+        for (int i = 0; i < config.n; ++i) {
+            std::fill(row.begin(), row.end(), 0.0);
+            for (int x = 0; x < config.k; ++x) {
+                double av = summaCell(config.seed, 0, i, x);
+                for (int j = 0; j < config.m; ++j) {
+                    row[j] += av * summaCell(config.seed, 1, x, j);
+                }
+            }
+            double sum = 0;
+            for (double v : row) {
+                sum += std::abs(v);
+            }
+            expected = std::max(expected, sum);
+        }
+        std::cout << "Single-process norm: " << expected << (expected == norm ? " (match)" : " (MISMATCH)")
+                  << std::endl;
+    }
+}
+
+// Split a comma-separated list, dropping empty items
+std::vector<std::string> splitList(const std::string& list) {
+    std::vector<std::string> items;
+    for (size_t start = 0; start <= list.size();) {
+        size_t end = std::min(list.find(',', start), list.size());
+        if (end > start) {
+            items.push_back(list.substr(start, end - start));
+        }
+        start = end + 1;
+    }
+    return items;
+}
+
+int main(const int argc, const char* argv[]) {
+    // Options may appear anywhere, the remaining arguments are positional
+    std::vector<std::string> args;
+    int checkpointRows = 64;
+    unsigned seed = static_cast<unsigned>(std::time(nullptr)); // Of random matrices
+    bool verify = false;
+    bool profile = false;
+    DatabaseOptions options;
+    for (int i = 0; i < argc; ++i) {
+        if (std::string(argv[i]) == "--verify") {
+            verify = true;
+        } else if (std::string(argv[i]) == "--profile") {
+            profile = true;
+        } else if (std::string(argv[i]) == "--checkpoint" && i + 1 < argc) {
+            checkpointRows = std::stoi(argv[++i]);
+        } else if (std::string(argv[i]) == "--seed" && i + 1 < argc) {
+            seed = std::stoul(argv[++i]);
+        } else if (std::string(argv[i]) == "--write-behind" && i + 1 < argc) {
+            options.writeBehind = std::stoul(argv[++i]);
+        } else if (std::string(argv[i]) == "--page-size" && i + 1 < argc) {
+            options.pageSize = std::stoul(argv[++i]);
+        } else if (std::string(argv[i]) == "--ffactor" && i + 1 < argc) {
+            options.fillFactor = std::stoul(argv[++i]);
+        } else if (std::string(argv[i]) == "--partitions" && i + 1 < argc) {
+            options.partitions = std::max(1, std::stoi(argv[++i]));
+        } else if (std::string(argv[i]) == "--partition-dirs" && i + 1 < argc) {
+            options.partitionDirs = splitList(argv[++i]);
+        } else if (std::string(argv[i]) == "--shared") {
+            options.shared = true;
+        } else if (std::string(argv[i]) == "--storage" && i + 1 < argc) {
+            if (!parseStorageEngine(argv[++i], options.engine)) {
+                std::cerr << "Error: Unknown storage engine " << argv[i] << "." << std::endl;
+                std::exit(1);
+            }
+        } else {
+            args.push_back(argv[i]);
+        }
+    }
+    const int argCount = args.size();
+
+    bool import = argCount > 2 && args[2] == "--import";
+    bool open = argCount > 2 && args[2] == "--open";
+    bool summa = argCount > 2 && args[2] == "--summa";
+    if ((!import && !open && argCount < 6) || (import && argCount < 5) || (summa && argCount < 7)) {
+        std::cerr << "Usage: " << argv[0] << " database_name <Matrix A row col> <Matrix B row col> [export_file]" << std::endl;
+        std::cerr << "       " << argv[0] << " database_name --import matrix_a_file matrix_b_file [export_file]" << std::endl;
+        std::cerr << "       " << argv[0] << " database_name --open [export_file]" << std::endl;
+        std::cerr << "       " << argv[0] << " database_name --summa grid n k m   (grid x grid worker processes)"
+                  << std::endl;
+        std::cerr << "Options: --checkpoint rows  Rows of A x B computed between checkpoints (default 64)" << std::endl;
+        std::cerr << "         --seed n           Seed of the random matrices (default: the time). An interrupted"
+                  << std::endl;
+        std::cerr << "                            product of random matrices only resumes from its checkpoint when"
+                  << std::endl;
+        std::cerr << "                            rerun with the same seed; --open resumes with the stored inputs"
+                  << std::endl;
+        std::cerr << "         --page-size bytes  Page size of new matrix databases" << std::endl;
+        std::cerr << "         --ffactor n        Hash fill factor (records per bucket)" << std::endl;
+        std::cerr << "         --shared           Share the environment with concurrent readers" << std::endl;
+        std::cerr << "         --storage engine   Storage engine: bdb (default), memory or mmap" << std::endl;
+        std::cerr << "         --partitions n     Split each matrix database into n files by key hash" << std::endl;
+        std::cerr << "         --partition-dirs d1,d2,...  Directories the partitions go to, round robin" << std::endl;
+        std::cerr << "         --write-behind n   Queue up to n cell writes for a background flusher" << std::endl;
+        std::cerr << "         --verify           Check the --summa product against a single-process one" << std::endl;
+        std::cerr << "         --profile          Report hardware counters per phase (load, multiply, ...)" << std::endl;
+        std::exit(1);
+    }
+
+    std::string database_name = args[1];
+    if (summa) {
+        timeval start;
+        gettimeofday(&start, nullptr);
+        try {
+            SummaConfig config = {database_name, std::max(1, std::stoi(args[3])), std::stoi(args[4]),
+                                  std::stoi(args[5]), std::stoi(args[6]), seed};
+            multiplySumma(config, options, verify);
+        } catch (const std::exception& e) {
+            std::cerr << "Error: Invalid arguments." << std::endl;
+            std::exit(1);
+        }
+        printTotalTime(start);
+        return 0;
+    }
+
+    const int exportArg = open ? 3 : import ? 5 : 6; // Index of optional export file
 
     timeval start; // Start timer
-    gettimeofday(&start, nullptr);
+    PhaseProfiler profiler(profile);
+    Matrix<>* ma;
+    Matrix<>* mb;
+
+    if (open) {
+        gettimeofday(&start, nullptr);
+        profiler.phase("load");
+
+        // Reuse matrices stored by an earlier run
+        ma = new Matrix<>(database_name + "_a", options);
+        mb = new Matrix<>(database_name + "_b", options);
+    } else if (import) {
+        gettimeofday(&start, nullptr);
+        profiler.phase("load");
+
+        // Stream matrices from files into database
+        ma = new Matrix<>(database_name + "_a", args[3], options);
+        mb = new Matrix<>(database_name + "_b", args[4], options);
+    } else {
+        if (std::stoi(args[3]) != std::stoi(args[4])) {
+            std::cerr << "Cannot multiply matrix A and B" << std::endl;
+            exit(1);
+        }
+
+        int n = std::stoi(args[2]);
+        int k = std::stoi(args[3]);
+        int m = std::stoi(args[5]);
+
+        // Matrix of vectors
+        std::vector<std::vector<double>> A(n, std::vector<double>(k, 0.0));
+        std::vector<std::vector<double>> B(k, std::vector<double>(m, 0.0));
+
+        // Fill matrix with random values. The seed is printed, so that an
+        // interrupted product can be resumed with the same inputs.
+        std::cout << "Random matrices with seed " << seed << "..." << std::endl;
+        std::srand(seed);
+        fillMatrix(A);
+        fillMatrix(B);
+
+        gettimeofday(&start, nullptr);
+
+        if (n == FIXED_SIZE && k == FIXED_SIZE && m == FIXED_SIZE) {
+            multiplyFixed<FIXED_SIZE, FIXED_SIZE, FIXED_SIZE>(database_name, A, B, options,
+                                                              argCount > exportArg ? args[exportArg] : "", profiler);
+            profiler.printReport();
+            printTotalTime(start);
+            return 0;
+        }
+
+        // Store matrices in database
+        profiler.phase("load");
+        ma = new Matrix<>(database_name + "_a", A, options);
+        mb = new Matrix<>(database_name + "_b", B, options);
+    }
 
-    // Store matrices in database
-    Matrix* ma = new Matrix(database_name + "_a", A);
-    Matrix* mb = new Matrix(database_name + "_b", B);
+    if (ma->colCount() != mb->rowCount()) {
+        std::cerr << "Cannot multiply matrix A and B" << std::endl;
+        exit(1);
+    }
 
     // Multiply matrices and store in database
-    Matrix* mc = new Matrix(database_name + "_c", *ma, *mb);
+    profiler.phase("multiply");
+    Matrix<>* mc = new Matrix<>(database_name + "_c", *ma, *mb, checkpointRows, options);
 
     // Print matrices
+    profiler.phase("print");
     std::cout << "\nMatrix A:" << std::endl;
     ma->print();
     std::cout << "\nMatrix B:" << std::endl;
     mb->print();
     std::cout << "\nMatrix A x B:" << std::endl;
     mc->print();
+    profiler.phase("norm");
+    std::cout << "\nInfinity Norm of A x B: " << mc->productNorm() << std::endl; // Reduced by the multiply
     std::cout << std::endl;
 
+    profiler.phase("report"); // Page statistics and export
+    ma->printPageReport();
+    mb->printPageReport();
+    mc->printPageReport();
+    std::cout << std::endl;
+
+    if (argCount > exportArg) {
+        mc->exportTo(args[exportArg]); // Export A x B as CSV, or raw binary for .bin
+    }
+
+    profiler.phase("close");
     delete ma;
     delete mb;
     delete mc;
 
-    timeval elapsed;
-    gettimeofday(&elapsed, nullptr);
-
-    // Total elapsed time
-    std::cout << "\nTotal time taken: ";
-    printElapsedTime(start, elapsed); // Print elapsed
-    std::cout << ".\n";
+    profiler.printReport();
+    printTotalTime(start);
 
     return 0;
 }
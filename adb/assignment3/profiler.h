@@ -0,0 +1,188 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstring> // strerror
+#include <iomanip>
+#include <iostream>
+#include <linux/perf_event.h>
+#include <string>
+#include <sys/syscall.h> // SYS_perf_event_open
+#include <unistd.h> // read, close
+#include <vector>
+
+// Hardware counters per named phase of a run, from perf_event_open(2).
+// Counters cover the whole process, threads started later included, and
+// run from construction; a phase reports their growth between phase()
+// calls. Counters the machine or the perf_event_paranoid setting does
+// not allow are reported as n/a. A disabled profiler does nothing.
+class PhaseProfiler {
+  private:
+    enum Counter {
+        CYCLES,
+        INSTRUCTIONS,
+        LLC_MISSES,
+        DTLB_MISSES,
+        CONTEXT_SWITCHES,
+        COUNTER_COUNT
+    };
+
+    struct Phase {
+        std::string name;
+        double milliseconds;
+        double counts[COUNTER_COUNT]; // -1 = not available
+    };
+
+    bool mEnabled;
+    int mFds[COUNTER_COUNT];
+    double mStart[COUNTER_COUNT]; // Readings at the start of the current phase
+    std::chrono::steady_clock::time_point mStartTime;
+    std::string mCurrent; // Name of the current phase, empty = none
+    std::vector<Phase> mPhases;
+
+    static int open(uint32_t type, uint64_t config, bool kernel);
+    double read(int counter); // Scaled for multiplexing, -1 if unavailable
+    void finishPhase();
+
+  public:
+    explicit PhaseProfiler(bool enabled);
+    ~PhaseProfiler();
+
+    void phase(const std::string& name); // End the current phase, start the next
+    void stop(); // End the current phase
+    void printReport();
+};
+
+inline PhaseProfiler::PhaseProfiler(bool enabled) : mEnabled(enabled) {
+    for (int c = 0; c < COUNTER_COUNT; ++c) {
+        mFds[c] = -1;
+    }
+    if (!mEnabled) {
+        return;
+    }
+
+    const uint64_t LLC_READ_MISS = PERF_COUNT_HW_CACHE_LL | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                                   (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+    const uint64_t DTLB_READ_MISS = PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                                    (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+    const uint32_t types[COUNTER_COUNT] = {PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HW_CACHE,
+                                           PERF_TYPE_HW_CACHE, PERF_TYPE_SOFTWARE};
+    const uint64_t configs[COUNTER_COUNT] = {PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS, LLC_READ_MISS,
+                                             DTLB_READ_MISS, PERF_COUNT_SW_CONTEXT_SWITCHES};
+
+    int available = 0;
+    for (int c = 0; c < COUNTER_COUNT; ++c) {
+        // Kernel time shows what system calls cost; without the privilege
+        // to count it, count user space only
+        mFds[c] = open(types[c], configs[c], true);
+        if (mFds[c] < 0) {
+            mFds[c] = open(types[c], configs[c], false);
+        }
+        available += mFds[c] >= 0;
+    }
+    if (available == 0) {
+        std::cerr << "Warning: No performance counters available (" << std::strerror(errno)
+                  << "), profiling phase times only.\n";
+    }
+}
+
+inline PhaseProfiler::~PhaseProfiler() {
+    for (int fd : mFds) {
+        if (fd >= 0) {
+            ::close(fd);
+        }
+    }
+}
+
+inline int PhaseProfiler::open(uint32_t type, uint64_t config, bool kernel) {
+    perf_event_attr attr = {};
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.inherit = 1; // Count threads created later, such as the write-behind flusher
+    attr.exclude_kernel = kernel ? 0 : 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    return syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0); // This process, any CPU
+}
+
+// More counters than hardware registers are time-multiplexed; scale the
+// count to the time the counter was enabled
+inline double PhaseProfiler::read(int counter) {
+    uint64_t values[3]; // Value, time enabled, time running
+    if (mFds[counter] < 0 || ::read(mFds[counter], values, sizeof(values)) != sizeof(values)) {
+        return -1;
+    }
+    return values[2] > 0 ? static_cast<double>(values[0]) * values[1] / values[2] : 0;
+}
+
+inline void PhaseProfiler::phase(const std::string& name) {
+    if (!mEnabled) {
+        return;
+    }
+    finishPhase();
+    mCurrent = name;
+    for (int c = 0; c < COUNTER_COUNT; ++c) {
+        mStart[c] = read(c);
+    }
+    mStartTime = std::chrono::steady_clock::now();
+}
+
+inline void PhaseProfiler::stop() {
+    finishPhase();
+}
+
+inline void PhaseProfiler::finishPhase() {
+    if (mCurrent.empty()) {
+        return;
+    }
+
+    Phase p;
+    p.name = mCurrent;
+    p.milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - mStartTime).count();
+    for (int c = 0; c < COUNTER_COUNT; ++c) {
+        double now = read(c);
+        p.counts[c] = now >= 0 && mStart[c] >= 0 ? now - mStart[c] : -1;
+    }
+    mPhases.push_back(p);
+    mCurrent.clear();
+}
+
+inline void PhaseProfiler::printReport() {
+    stop();
+    if (mPhases.empty()) {
+        return;
+    }
+
+    auto count = [](double v) {
+        std::cout << '\t';
+        if (v < 0) {
+            std::cout << "n/a";
+        } else {
+            std::cout << static_cast<long long>(v);
+        }
+    };
+
+    std::cout << "\nPhase\t\tTime(ms)\tCycles\t\tInstructions\tIPC\tLLC misses\tdTLB misses\tContext switches\n";
+    std::cout << std::fixed << std::setprecision(2);
+    for (const Phase& p : mPhases) {
+        std::cout << p.name << (p.name.size() < 8 ? "\t\t" : "\t") << p.milliseconds;
+        count(p.counts[CYCLES]);
+        count(p.counts[INSTRUCTIONS]);
+        std::cout << '\t';
+        if (p.counts[CYCLES] > 0 && p.counts[INSTRUCTIONS] >= 0) {
+            std::cout << p.counts[INSTRUCTIONS] / p.counts[CYCLES];
+        } else {
+            std::cout << "n/a";
+        }
+        count(p.counts[LLC_MISSES]);
+        count(p.counts[DTLB_MISSES]);
+        count(p.counts[CONTEXT_SWITCHES]);
+        std::cout << '\n';
+    }
+    std::cout << std::defaultfloat;
+}
+
+#endif
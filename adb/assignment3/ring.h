@@ -0,0 +1,80 @@
+#ifndef RING_H
+#define RING_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Bounded lock-free queue for many producers and one consumer. Each slot
+// carries a sequence number: a producer claims a position by advancing
+// the tail, fills the slot and publishes it by bumping its sequence; the
+// consumer takes slots in position order and hands them back to the
+// producers one lap ahead.
+template <typename T>
+class MpscRing {
+  private:
+    struct Slot {
+        std::atomic<size_t> sequence;
+        T value;
+    };
+
+    std::vector<Slot> mSlots;
+    size_t mMask; // Capacity - 1, capacity is a power of two
+    alignas(64) std::atomic<size_t> mTail; // Next position to claim, shared by producers
+    alignas(64) size_t mHead; // Next position to take, consumer only
+
+  public:
+    explicit MpscRing(size_t capacity) : mSlots(roundUp(capacity)), mMask(mSlots.size() - 1), mTail(0), mHead(0) {
+        for (size_t i = 0; i < mSlots.size(); ++i) {
+            mSlots[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    size_t capacity() const { return mSlots.size(); }
+
+    // Append value. False if the ring is full.
+    bool tryPush(const T& value) {
+        size_t pos = mTail.load(std::memory_order_relaxed);
+        for (;;) {
+            Slot& slot = mSlots[pos & mMask];
+            intptr_t diff = static_cast<intptr_t>(slot.sequence.load(std::memory_order_acquire)) -
+                            static_cast<intptr_t>(pos);
+            if (diff == 0) {
+                if (mTail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    slot.value = value;
+                    slot.sequence.store(pos + 1, std::memory_order_release); // Publish to the consumer
+                    return true;
+                }
+            } else if (diff < 0) {
+                return false; // Slot not yet taken by the consumer: full
+            } else {
+                pos = mTail.load(std::memory_order_relaxed); // Claimed by another producer
+            }
+        }
+    }
+
+    // Take the oldest value. False if the ring is empty, or its oldest
+    // slot is claimed but not yet filled. Consumer thread only.
+    bool tryPop(T& value) {
+        Slot& slot = mSlots[mHead & mMask];
+        if (slot.sequence.load(std::memory_order_acquire) != mHead + 1) {
+            return false;
+        }
+        value = slot.value;
+        slot.sequence.store(mHead + mSlots.size(), std::memory_order_release); // Free for the next lap
+        ++mHead;
+        return true;
+    }
+
+  private:
+    static size_t roundUp(size_t capacity) {
+        size_t size = 2;
+        while (size < capacity) {
+            size *= 2;
+        }
+        return size;
+    }
+};
+
+#endif
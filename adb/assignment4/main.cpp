@@ -1,102 +1,313 @@
-#include <ctime>
+#include <algorithm>
+#include <charconv> // to_chars, from_chars
+#include <chrono>
+#include <cmath> // sqrt
+#include <cstdint>
 #include <cstring> // memcpy
+#include <ctime>
 #include <db_cxx.h> // Berkeley DB
 #include <exception>
+#include <fcntl.h> // open
 #include <iostream>
-#include <random> // srand, rand
+#include <random> // srand, rand, mt19937
 #include <string>
 #include <sys/time.h> // gettimeofday
+#include <sys/wait.h> // waitpid
+#include <unistd.h> // read, write, close, fork, pipe
 #include <vector>
 
+#include "bdb_storage.h"
+#include "storage.h"
+
 enum DbErrorCode {
     DB_SUCCESS,
     DB_ERROR,
 };
 
+// Options of a Database: its storage engine and, with the Berkeley DB
+// settings, how its records are spread over files.
+struct DatabaseOptions : BdbOptions {
+    StorageEngine engine = StorageEngine::BDB;
+    // Split each database into this many files, records spread by a hash
+    // of their key. Partition i is stored in partitionDirs[i % size], or
+    // in home if none are given, e.g. one directory per disk. A database
+    // must be reopened with the partitioning it was written with.
+    int partitions = 1;
+    std::vector<std::string> partitionDirs;
+};
+
+// Options with the nelem hint set for a matrix of cells cells, unless given
+inline DatabaseOptions expectRecords(DatabaseOptions options, long long cells) {
+    if (options.expectedRecords == 0) {
+        options.expectedRecords = std::min<long long>(cells + 2, UINT32_MAX); // Cells and named records
+    }
+    return options;
+}
+
+// Storage engine of one database, or of one partition of it, in options.home
+inline Storage* openStorage(const std::string& name, const DatabaseOptions& options) {
+    switch (options.engine) {
+    case StorageEngine::MEMORY:
+        return new MemoryStorage(name);
+    case StorageEngine::MMAP:
+        return new MmapStorage(options.home + "/" + name + ".mmap");
+    case StorageEngine::BDB:
+    default:
+        return new BdbStorage(name, options);
+    }
+}
+
 class Database {
   private:
-    DbEnv* mEnv; // Berkeley DB environment variable
-    Db* mDatabase; // Berkeley DB connection
+    Storage* mStorage; // Storage engine
     std::string dbName;
 
   public:
-    Database(const std::string dbName) : mEnv(nullptr), mDatabase(nullptr), dbName(dbName) {
-        mEnv = new DbEnv(0); // Berkeley DB Environment
-        mEnv->set_error_stream(&std::cerr); // Set error stream
-        mEnv->set_cachesize(0, 64 * 1024, 0); // Allocate cache memory
-
-        try {
-            mEnv->open("./db", DB_CREATE | DB_INIT_MPOOL, 0); // Open environment
-        } catch (const DbException& e) {
-            std::cerr << "Error: Unable to open db.\n";
-            std::cerr << e.what() << std::endl;
-            std::exit(DbErrorCode::DB_ERROR);
-        } catch (const std::exception& e) {
-            std::cerr << "Error: Unable to create environment.\n";
-            std::cerr << e.what() << std::endl;
-            std::exit(DbErrorCode::DB_ERROR);
+    Database(const std::string dbName, const DatabaseOptions& options = DatabaseOptions())
+        : mStorage(nullptr), dbName(dbName) {
+        std::cout << "Opening database " << dbName << "...\n";
+        if (options.partitions <= 1) {
+            mStorage = openStorage(dbName, options);
+            return;
         }
 
-        std::cout << "Opening database " << dbName << "...\n";
-        try {
-            mDatabase = new Db(mEnv, 0); // Database
-            // Open the database
-            mDatabase->open(nullptr, (dbName + ".db").c_str(), nullptr, DB_HASH, DB_CREATE, 0);
-        } catch (const DbException& e) {
-            std::cerr << "Error opening database.\n";
-            std::cerr << e.what() << std::endl;
-            std::exit(DbErrorCode::DB_ERROR);
-        } catch (const std::exception& e) {
-            std::cerr << e.what() << std::endl;
-            std::exit(DbErrorCode::DB_ERROR);
+        // Partition i is the database dbName_pi
+        DatabaseOptions partitionOptions = options;
+        if (options.expectedRecords > 0) {
+            partitionOptions.expectedRecords = options.expectedRecords / options.partitions + 1;
+        }
+        std::vector<Storage*> partitions;
+        for (int i = 0; i < options.partitions; ++i) {
+            if (!options.partitionDirs.empty()) {
+                partitionOptions.home = options.partitionDirs[i % options.partitionDirs.size()];
+            }
+            partitions.push_back(openStorage(dbName + "_p" + std::to_string(i), partitionOptions));
         }
+        mStorage = new PartitionedStorage(partitions);
     }
 
     ~Database() {
         std::cout << "Closing database " << dbName << "...\n";
-        mDatabase->close(0); // Close the database
-        mEnv->close(0); // Close the environment
-
-        delete mDatabase;
-        delete mEnv;
+        delete mStorage; // Close the storage engine
     }
 
     const double get(const int row, const int col); // Fetch the value
     void put(const int row, const int col, double v); // Store the value
+    bool getRecord(const std::string& name, void* data, size_t size); // Fetch a named record
+    void putRecord(const std::string& name, const void* data, size_t size); // Store a named record
+    void removeRecord(const std::string& name); // Delete a named record
+    void sync(); // Flush dirty pages to disk
+    void printPageReport(); // Records and space used by the storage engine
+    // Gets until endSnapshot() read one consistent state, while writers go on
+    void beginSnapshot();
+    void endSnapshot();
 };
 
 inline const double Database::get(const int row, const int col) {
-    // Make key using row and column
-    std::string keyString(std::to_string(row) + std::to_string(col));
+    // Make key using row and column. Fixed width, so (1, 11) and (11, 1) differ.
+    int k[2] = {row, col};
+    double v = 0;
 
-    // Conver keyString to char string
-    char* k = new char[keyString.size()];
-    std::memcpy(k, keyString.c_str(), keyString.size());
+    mStorage->get(k, sizeof(k), &v, sizeof(v)); // Retrieve the value
+    return v; // Return the value
+}
 
-    // Make database key and value
-    Dbt key(static_cast<void*>(k), keyString.size());
-    Dbt value;
+inline void Database::put(const int row, const int col, double v) {
+    // Make key using row and column. Fixed width, so (1, 11) and (11, 1) differ.
+    int k[2] = {row, col};
 
-    this->mDatabase->get(nullptr, &key, &value, 0); // Retrieve the value
-    return *static_cast<double*>(value.get_data()); // Return the value
-    // return 0;
+    mStorage->put(k, sizeof(k), &v, sizeof(v)); // Set/update value
 }
 
-inline void Database::put(const int row, const int col, double v) {
-    // Make key using row and column
-    std::string keyString(std::to_string(row) + std::to_string(col));
+// Named records never collide with cells, whose keys are exactly two ints
+inline bool Database::getRecord(const std::string& name, void* data, size_t size) {
+    return mStorage->get(name.data(), name.size(), data, size);
+}
+
+inline void Database::putRecord(const std::string& name, const void* data, size_t size) {
+    mStorage->put(name.data(), name.size(), data, size);
+}
+
+inline void Database::removeRecord(const std::string& name) {
+    mStorage->remove(name.data(), name.size());
+}
+
+inline void Database::sync() {
+    mStorage->sync();
+}
+
+inline void Database::printPageReport() {
+    mStorage->printReport();
+}
+
+inline void Database::beginSnapshot() {
+    mStorage->beginSnapshot();
+}
+
+inline void Database::endSnapshot() {
+    mStorage->endSnapshot();
+}
+
+// Buffered writer on top of a file descriptor. Values are formatted with
+// std::to_chars straight into a large buffer which is written out with one
+// write(2) call per buffer, instead of one stream flush per line.
+class BufferedWriter {
+  private:
+    int mFd;
+    bool mOwnsFd; // Close the descriptor on destruction
+    std::vector<char> mBuffer;
+    size_t mSize; // Bytes pending in buffer
+
+  public:
+    BufferedWriter(int fd, size_t capacity = 1 << 20) : mFd(fd), mOwnsFd(false), mBuffer(capacity), mSize(0) {}
+
+    BufferedWriter(const std::string& path, size_t capacity = 1 << 20)
+        : mFd(-1), mOwnsFd(true), mBuffer(capacity), mSize(0) {
+        mFd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (mFd < 0) {
+            std::cerr << "Error: Unable to open " << path << " for writing.\n";
+            std::exit(DbErrorCode::DB_ERROR);
+        }
+    }
+
+    ~BufferedWriter() {
+        flush();
+        if (mOwnsFd) {
+            ::close(mFd);
+        }
+    }
+
+    void write(const char* data, size_t n);
+    void write(char c);
+    void write(double v);
+    void flush();
+};
+
+inline void BufferedWriter::write(const char* data, size_t n) {
+    if (mSize + n > mBuffer.size()) {
+        flush();
+    }
+    std::memcpy(mBuffer.data() + mSize, data, n);
+    mSize += n;
+}
 
-    // Conver keyString to char string
-    char* k = new char[keyString.size()];
-    std::memcpy(k, keyString.c_str(), keyString.size());
+inline void BufferedWriter::write(char c) {
+    if (mSize == mBuffer.size()) {
+        flush();
+    }
+    mBuffer[mSize++] = c;
+}
+
+inline void BufferedWriter::write(double v) {
+    // Shortest round-trip representation is at most 24 characters
+    if (mSize + 32 > mBuffer.size()) {
+        flush();
+    }
+    char* end = std::to_chars(mBuffer.data() + mSize, mBuffer.data() + mBuffer.size(), v).ptr;
+    mSize = end - mBuffer.data();
+}
+
+inline void BufferedWriter::flush() {
+    size_t written = 0;
+    while (written < mSize) {
+        ssize_t n = ::write(mFd, mBuffer.data() + written, mSize - written);
+        if (n < 0) {
+            std::cerr << "Error: Write failed.\n";
+            std::exit(DbErrorCode::DB_ERROR);
+        }
+        written += n;
+    }
+    mSize = 0;
+}
+
+// Chunked reader on top of a file descriptor, counterpart of BufferedWriter.
+// Only the unconsumed tail of the current chunk is kept in memory.
+class BufferedReader {
+  private:
+    int mFd;
+    std::vector<char> mBuffer;
+    size_t mBegin; // First unconsumed byte
+    size_t mEnd; // One past last valid byte
+
+  public:
+    BufferedReader(const std::string& path, size_t capacity = 1 << 20)
+        : mFd(-1), mBuffer(capacity), mBegin(0), mEnd(0) {
+        mFd = ::open(path.c_str(), O_RDONLY);
+        if (mFd < 0) {
+            std::cerr << "Error: Unable to open " << path << " for reading.\n";
+            std::exit(DbErrorCode::DB_ERROR);
+        }
+    }
+
+    ~BufferedReader() {
+        ::close(mFd);
+    }
+
+    const char* begin() { return mBuffer.data() + mBegin; }
+    const char* end() { return mBuffer.data() + mEnd; }
+    size_t size() { return mEnd - mBegin; }
+    void consume(size_t n) { mBegin += n; }
+
+    bool fill();
+    size_t read(char* dst, size_t n);
+};
 
-    // Make database key and value
-    Dbt key(static_cast<void*>(k), keyString.size());
-    Dbt value(static_cast<void*>(&v), sizeof(v));
+// Read the next chunk after the unconsumed bytes. Returns false at end of file.
+inline bool BufferedReader::fill() {
+    // Move unconsumed bytes to the front, grow if a single record fills the buffer
+    std::memmove(mBuffer.data(), mBuffer.data() + mBegin, mEnd - mBegin);
+    mEnd -= mBegin;
+    mBegin = 0;
+    if (mEnd == mBuffer.size()) {
+        mBuffer.resize(mBuffer.size() * 2);
+    }
 
-    this->mDatabase->put(nullptr, &key, &value, 0); // Set/update value
+    ssize_t n = ::read(mFd, mBuffer.data() + mEnd, mBuffer.size() - mEnd);
+    if (n < 0) {
+        std::cerr << "Error: Read failed.\n";
+        std::exit(DbErrorCode::DB_ERROR);
+    }
+    mEnd += n;
+    return n > 0;
+}
+
+// Copy up to n bytes into dst, returns number of bytes copied
+inline size_t BufferedReader::read(char* dst, size_t n) {
+    size_t copied = 0;
+    while (copied < n) {
+        if (size() == 0 && !fill()) {
+            break;
+        }
+        size_t len = std::min(n - copied, size());
+        std::memcpy(dst + copied, begin(), len);
+        consume(len);
+        copied += len;
+    }
+    return copied;
 }
 
+// True if path names a raw binary matrix file
+inline bool isBinaryPath(const std::string& path) {
+    return path.size() >= 4 && path.compare(path.size() - 4, 4, ".bin") == 0;
+}
+
+// Header stored with every matrix, so that it can be reopened without
+// rewriting its cells. Written last, once all cells are stored.
+struct MatrixHeader {
+    uint32_t magic;
+    uint32_t version;
+    int32_t rows;
+    int32_t cols;
+    uint32_t encoding; // Cell value encoding
+    uint32_t layout; // Cell key layout
+};
+
+const std::string MATRIX_HEADER_KEY = "__matrix_header";
+const uint32_t MATRIX_MAGIC = 0x4d545258; // "MTRX"
+const uint32_t MATRIX_VERSION = 1;
+const uint32_t MATRIX_ENCODING_DOUBLE = 1; // Native 8-byte double
+const uint32_t MATRIX_LAYOUT_ROW_COL = 1; // Key is int {row, col}
+
 class Matrix : public Database {
   private:
     int row;
@@ -104,7 +315,29 @@ class Matrix : public Database {
     std::string name; // Database name
 
   public:
-    Matrix(std::string matrixName, int n) : Database(matrixName), row(n), col(n), name(matrixName) {
+    // Open a matrix stored by an earlier run. Only the header is read.
+    Matrix(std::string matrixName, const DatabaseOptions& options = DatabaseOptions())
+        : Database(matrixName, options), row(0), col(0), name(matrixName) {
+        readHeader();
+    }
+
+    // Load the matrix from a CSV or raw binary (.bin) file
+    Matrix(std::string matrixName, const std::string& path, const DatabaseOptions& options = DatabaseOptions())
+        : Database(matrixName, options), row(0), col(0), name(matrixName) {
+        std::cout << "Importing matrix from " << path << "...\n";
+        clearHeader();
+        if (isBinaryPath(path)) {
+            importBinary(path);
+        } else {
+            importCsv(path);
+        }
+        writeHeader();
+    }
+
+    Matrix(std::string matrixName, int n, const DatabaseOptions& options = DatabaseOptions())
+        : Database(matrixName, expectRecords(options, static_cast<long long>(n) * n)), row(n), col(n),
+          name(matrixName) {
+        clearHeader();
         // Initialize the matrix to zero values
         for (int i = 0; i < row; ++i) {
             for (int j = 0; j < col; ++j) {
@@ -112,15 +345,30 @@ class Matrix : public Database {
                 this->Database::put(i, j, std::rand() % 100);
             }
         }
+        writeHeader();
     }
 
     int rowCount() { return this->row; }
     int colCount() { return this->col; }
     int computeInfinityNorm();
+    std::vector<double> multiplyVector(const std::vector<double>& x);
+    double estimateSpectralNorm(int maxIterations = 100, double tolerance = 1e-9);
     void print();
+    void exportCsv(const std::string& path);
+    void exportBinary(const std::string& path);
+    void exportTo(const std::string& path);
+    void importCsv(const std::string& path);
+    void importBinary(const std::string& path);
+
+  private:
+    void clearHeader();
+    void writeHeader();
+    void readHeader();
+    double multiplyRow(int i, const std::vector<double>& x, std::vector<double>& rowBuffer);
 };
 
 inline int Matrix::computeInfinityNorm() {
+    this->beginSnapshot(); // All rows from one state of the matrix
     int infNorm = 0;
     for (int i = 0; i < this->row; ++i) {
         int rowSum = 0;
@@ -130,16 +378,262 @@ inline int Matrix::computeInfinityNorm() {
 
         infNorm = std::max(infNorm, rowSum);
     }
+    this->endSnapshot();
 
     return infNorm;
 }
 
+// Read row i into rowBuffer and return (A * x)[i], so that callers
+// can use the row again without reading it twice
+inline double Matrix::multiplyRow(int i, const std::vector<double>& x, std::vector<double>& rowBuffer) {
+    double sum = 0;
+    for (int j = 0; j < this->col; ++j) {
+        rowBuffer[j] = this->get(i, j);
+        sum += rowBuffer[j] * x[j];
+    }
+    return sum;
+}
+
+// Compute y = A * x with one row-major pass over the matrix
+inline std::vector<double> Matrix::multiplyVector(const std::vector<double>& x) {
+    std::vector<double> y(this->row, 0.0);
+    std::vector<double> rowBuffer(this->col);
+    for (int i = 0; i < this->row; ++i) {
+        y[i] = multiplyRow(i, x, rowBuffer);
+    }
+
+    return y;
+}
+
+// Estimate the 2-norm (largest singular value) by power iteration on A^T * A.
+// Only x is kept in memory; every iteration streams A once, computing
+// (A * x)[i] from row i and then adding its contribution to A^T * (A * x)
+// from the same buffered row.
+inline double Matrix::estimateSpectralNorm(int maxIterations, double tolerance) {
+    if (this->row == 0 || this->col == 0) {
+        return 0;
+    }
+
+    std::vector<double> x(this->col, 1.0 / std::sqrt(this->col)); // Unit start vector
+    std::vector<double> z(this->col);
+    std::vector<double> rowBuffer(this->col);
+    double norm = 0;
+    bool restarted = false;
+
+    this->beginSnapshot(); // Every iteration multiplies by the same matrix
+    for (int iter = 0; iter < maxIterations; ++iter) {
+        std::fill(z.begin(), z.end(), 0.0);
+        for (int i = 0; i < this->row; ++i) {
+            double y = multiplyRow(i, x, rowBuffer);
+            for (int j = 0; j < this->col; ++j) {
+                z[j] += y * rowBuffer[j];
+            }
+        }
+
+        // ||A^T A x|| converges to the largest eigenvalue of A^T A, i.e. sigma^2
+        double zNorm = 0;
+        for (double v : z) {
+            zNorm += v * v;
+        }
+        zNorm = std::sqrt(zNorm);
+        if (zNorm == 0) {
+            // x is in the null space of A. Every x is only when A is zero;
+            // otherwise a random start vector almost surely is not, so
+            // start again once from one.
+            if (restarted) {
+                this->endSnapshot();
+                return 0;
+            }
+            restarted = true;
+            std::mt19937 random(1);
+            std::normal_distribution<double> normal;
+            double length = 0;
+            for (double& v : x) {
+                v = normal(random);
+                length += v * v;
+            }
+            for (double& v : x) {
+                v /= std::sqrt(length);
+            }
+            continue;
+        }
+
+        double previous = norm;
+        norm = std::sqrt(zNorm);
+        for (int j = 0; j < this->col; ++j) {
+            x[j] = z[j] / zNorm;
+        }
+
+        if (std::abs(norm - previous) <= tolerance * norm) {
+            break;
+        }
+    }
+    this->endSnapshot();
+
+    return norm;
+}
+
+// Header is removed while cells are (re)written, so an interrupted
+// initialization cannot be reopened as a complete matrix
+inline void Matrix::clearHeader() {
+    removeRecord(MATRIX_HEADER_KEY);
+}
+
+inline void Matrix::writeHeader() {
+    MatrixHeader header = {MATRIX_MAGIC, MATRIX_VERSION, this->row, this->col, MATRIX_ENCODING_DOUBLE,
+                           MATRIX_LAYOUT_ROW_COL};
+    putRecord(MATRIX_HEADER_KEY, &header, sizeof(header));
+    sync();
+}
+
+inline void Matrix::readHeader() {
+    MatrixHeader header;
+    if (!getRecord(MATRIX_HEADER_KEY, &header, sizeof(header)) || header.magic != MATRIX_MAGIC) {
+        std::cerr << "Error: No complete matrix stored in database " << this->name << ".\n";
+        std::exit(DbErrorCode::DB_ERROR);
+    }
+    if (header.version != MATRIX_VERSION || header.encoding != MATRIX_ENCODING_DOUBLE ||
+        header.layout != MATRIX_LAYOUT_ROW_COL) {
+        std::cerr << "Error: Matrix " << this->name << " has unsupported format (version " << header.version
+                  << ", encoding " << header.encoding << ", layout " << header.layout << ").\n";
+        std::exit(DbErrorCode::DB_ERROR);
+    }
+
+    this->row = header.rows;
+    this->col = header.cols;
+    std::cout << "Opened " << this->row << "x" << this->col << " matrix " << this->name << ".\n";
+}
+
 inline void Matrix::print() {
+    std::cout.flush(); // Keep ordering with earlier std::cout output
+    BufferedWriter out(STDOUT_FILENO);
     for (int i = 0; i < this->row; ++i) {
         for (int j = 0; j < this->col; ++j) {
-            std::cout << this->get(i, j) << ' ';
+            out.write(this->get(i, j));
+            out.write(' ');
+        }
+        out.write('\n');
+    }
+}
+
+// Export matrix as CSV, one row per line
+inline void Matrix::exportCsv(const std::string& path) {
+    BufferedWriter out(path);
+    for (int i = 0; i < this->row; ++i) {
+        for (int j = 0; j < this->col; ++j) {
+            if (j > 0) {
+                out.write(',');
+            }
+            out.write(this->get(i, j));
+        }
+        out.write('\n');
+    }
+}
+
+// Export matrix as raw binary: int32 rows, int32 cols, then row-major doubles
+inline void Matrix::exportBinary(const std::string& path) {
+    BufferedWriter out(path);
+    int32_t header[2] = {this->row, this->col};
+    out.write(reinterpret_cast<const char*>(header), sizeof(header));
+    for (int i = 0; i < this->row; ++i) {
+        for (int j = 0; j < this->col; ++j) {
+            double v = this->get(i, j);
+            out.write(reinterpret_cast<const char*>(&v), sizeof(v));
+        }
+    }
+}
+
+// Export matrix, picking the format from the file extension (.bin or CSV)
+inline void Matrix::exportTo(const std::string& path) {
+    std::cout << "Exporting matrix to " << path << "...\n";
+    if (isBinaryPath(path)) {
+        exportBinary(path);
+    } else {
+        exportCsv(path);
+    }
+}
+
+// Import matrix from CSV, one row per line. Rows are parsed and stored
+// as each chunk arrives so the file is never held in memory.
+inline void Matrix::importCsv(const std::string& path) {
+    BufferedReader in(path);
+    this->row = 0;
+    this->col = 0;
+
+    bool more = true;
+    while (more || in.size() > 0) {
+        const char* first = in.begin();
+        const char* last = static_cast<const char*>(std::memchr(first, '\n', in.size()));
+        if (last == nullptr) {
+            if ((more = in.fill())) {
+                continue; // Line continues in next chunk
+            }
+            last = in.end(); // Last line without newline
+            first = in.begin();
+        }
+
+        int j = 0;
+        const char* p = first;
+        while (p < last) {
+            while (p < last && (*p == ' ' || *p == '\t' || *p == '\r')) {
+                ++p;
+            }
+            if (p == last) {
+                break;
+            }
+
+            double value;
+            std::from_chars_result res = std::from_chars(p, last, value);
+            if (res.ec != std::errc()) {
+                std::cerr << "Error: Invalid number in " << path << " at row " << this->row + 1 << ".\n";
+                std::exit(DbErrorCode::DB_ERROR);
+            }
+            this->Database::put(this->row, j++, value);
+
+            p = res.ptr;
+            while (p < last && (*p == ' ' || *p == '\t' || *p == '\r')) {
+                ++p;
+            }
+            if (p < last && *p == ',') {
+                ++p;
+            }
+        }
+        in.consume(last - first + (last < in.end() ? 1 : 0));
+
+        if (j == 0) {
+            continue; // Skip empty lines
+        }
+        if (this->row == 0) {
+            this->col = j;
+        } else if (j != this->col) {
+            std::cerr << "Error: Row " << this->row + 1 << " of " << path << " has " << j << " columns, expected "
+                      << this->col << ".\n";
+            std::exit(DbErrorCode::DB_ERROR);
+        }
+        ++this->row;
+    }
+}
+
+// Import matrix written by exportBinary()
+inline void Matrix::importBinary(const std::string& path) {
+    BufferedReader in(path);
+    int32_t header[2];
+    if (in.read(reinterpret_cast<char*>(header), sizeof(header)) != sizeof(header) || header[0] < 0 || header[1] < 0) {
+        std::cerr << "Error: Invalid matrix header in " << path << ".\n";
+        std::exit(DbErrorCode::DB_ERROR);
+    }
+    this->row = header[0];
+    this->col = header[1];
+
+    for (int i = 0; i < this->row; ++i) {
+        for (int j = 0; j < this->col; ++j) {
+            double v;
+            if (in.read(reinterpret_cast<char*>(&v), sizeof(v)) != sizeof(v)) {
+                std::cerr << "Error: Unexpected end of " << path << ".\n";
+                std::exit(DbErrorCode::DB_ERROR);
+            }
+            this->Database::put(i, j, v);
         }
-        std::cout << std::endl;
     }
 }
 
@@ -148,27 +642,209 @@ void printElapsedTime(const timeval& t1, const timeval& t2) {
 }
 
 
-int main(const int argc, const char* argv[]) {
-    if (argc < 3) {
-        std::cout << "Usage: " << argv[0] << " database_name matrix_size" << std::endl;
-        std::exit(1);
+// Run in a child process: open the shared matrix, read random cells for
+// the given time (or rewrite them, as the writer) and report the count
+// through fd. With snapshot, readers read each batch from a snapshot.
+void runBenchmarkProcess(const std::string& name, double seconds, bool writer, bool snapshot, int fd) {
+    std::cout.setstate(std::ios::failbit); // Keep open/close messages of children quiet
+    std::srand(getpid());
+
+    DatabaseOptions options;
+    options.shared = true;
+    options.snapshot = snapshot;
+    Matrix* matrix = new Matrix(name, options); // Own handles, none are inherited over fork
+
+    long long operations = 0;
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::duration<double>(seconds);
+    while (std::chrono::steady_clock::now() < deadline) {
+        if (!writer) {
+            matrix->beginSnapshot();
+        }
+        for (int batch = 0; batch < 256; ++batch, ++operations) {
+            int i = std::rand() % matrix->rowCount();
+            int j = std::rand() % matrix->colCount();
+            double v = matrix->get(i, j);
+            if (writer) {
+                matrix->put(i, j, v); // Same value, so readers always see the matrix
+            }
+        }
+        matrix->endSnapshot();
     }
+    delete matrix;
+
+    ::write(fd, &operations, sizeof(operations));
+    ::close(fd);
+}
+
+// Read throughput of 1, 2, 4, ... maxProcesses reader processes on one
+// shared environment, optionally next to a writer process, with
+// Concurrent Data Store locking or snapshot reads
+void benchmarkReaders(const std::string& name, int maxProcesses, double seconds, bool writer, bool snapshot) {
+    // Check the matrix before forking, and close it again: handles must
+    // not cross fork
+    DatabaseOptions options;
+    options.shared = true;
+    options.snapshot = snapshot;
+    Matrix* matrix = new Matrix(name, options); // Exits if no complete matrix is stored
+    delete matrix;
+
+    std::cout << "Reader processes\tReads/s\t\tReads/s per process" << (writer ? "\tWrites/s" : "") << std::endl;
+    for (int processes = 1; processes <= maxProcesses; processes *= 2) {
+        int total = processes + (writer ? 1 : 0);
+        std::vector<int> fds;
+        std::vector<pid_t> children;
+        for (int p = 0; p < total; ++p) {
+            int pipeFds[2];
+            if (pipe(pipeFds) != 0) {
+                std::cerr << "Error: Unable to create pipe.\n";
+                std::exit(DbErrorCode::DB_ERROR);
+            }
+
+            std::cout.flush(); // Nothing buffered may be written twice
+            pid_t pid = fork();
+            if (pid < 0) {
+                std::cerr << "Error: Unable to fork.\n";
+                std::exit(DbErrorCode::DB_ERROR);
+            }
+            if (pid == 0) {
+                ::close(pipeFds[0]);
+                runBenchmarkProcess(name, seconds, writer && p == processes, snapshot, pipeFds[1]);
+                _exit(0);
+            }
+            ::close(pipeFds[1]);
+            fds.push_back(pipeFds[0]);
+            children.push_back(pid);
+        }
 
-    int n;
+        long long reads = 0;
+        long long writes = 0;
+        for (int p = 0; p < total; ++p) {
+            long long operations = 0;
+            if (::read(fds[p], &operations, sizeof(operations)) != sizeof(operations)) {
+                std::cerr << "Error: Benchmark process " << children[p] << " failed.\n";
+            }
+            ::close(fds[p]);
+            waitpid(children[p], nullptr, 0);
+            (p < processes ? reads : writes) += operations;
+        }
+
+        std::cout << processes << "\t\t\t" << static_cast<long long>(reads / seconds) << "\t\t"
+                  << static_cast<long long>(reads / seconds / processes);
+        if (writer) {
+            std::cout << "\t\t\t" << static_cast<long long>(writes / seconds);
+        }
+        std::cout << std::endl;
+    }
+}
+
+// Split a comma-separated list, dropping empty items
+std::vector<std::string> splitList(const std::string& list) {
+    std::vector<std::string> items;
+    for (size_t start = 0; start <= list.size();) {
+        size_t end = std::min(list.find(',', start), list.size());
+        if (end > start) {
+            items.push_back(list.substr(start, end - start));
+        }
+        start = end + 1;
+    }
+    return items;
+}
+
+int main(const int argc, const char* argv[]) {
+    // Options may appear anywhere, the remaining arguments are positional
+    std::vector<std::string> args;
+    DatabaseOptions options;
+    bool writer = false;
     try {
-        n = std::stoi(argv[2]);
-    } catch (std::exception& e) {
-        std::cout << "Error: Invalid arguments" << std::endl;
+        for (int i = 0; i < argc; ++i) {
+            if (std::string(argv[i]) == "--page-size" && i + 1 < argc) {
+                options.pageSize = std::stoul(argv[++i]);
+            } else if (std::string(argv[i]) == "--ffactor" && i + 1 < argc) {
+                options.fillFactor = std::stoul(argv[++i]);
+            } else if (std::string(argv[i]) == "--shared") {
+                options.shared = true;
+            } else if (std::string(argv[i]) == "--snapshot") {
+                options.snapshot = true;
+            } else if (std::string(argv[i]) == "--partitions" && i + 1 < argc) {
+                options.partitions = std::max(1, std::stoi(argv[++i]));
+            } else if (std::string(argv[i]) == "--partition-dirs" && i + 1 < argc) {
+                options.partitionDirs = splitList(argv[++i]);
+            } else if (std::string(argv[i]) == "--writer") {
+                writer = true;
+            } else if (std::string(argv[i]) == "--storage" && i + 1 < argc) {
+                if (!parseStorageEngine(argv[++i], options.engine)) {
+                    throw std::invalid_argument(argv[i]);
+                }
+            } else {
+                args.push_back(argv[i]);
+            }
+        }
+    } catch (const std::exception& e) {
+        std::cout << "Error: Invalid option" << std::endl;
+        std::exit(1);
+    }
+    const int argCount = args.size();
+
+    if (argCount < 3 || ((args[2] == "--import" || args[2] == "--bench-readers") && argCount < 4)) {
+        std::cout << "Usage: " << argv[0] << " database_name matrix_size [export_file]" << std::endl;
+        std::cout << "       " << argv[0] << " database_name --import matrix_file [export_file]" << std::endl;
+        std::cout << "       " << argv[0] << " database_name --open [export_file]" << std::endl;
+        std::cout << "       " << argv[0] << " database_name --bench-readers max_processes [seconds]" << std::endl;
+        std::cout << "Options: --page-size bytes  Page size of a new matrix database" << std::endl;
+        std::cout << "         --ffactor n        Hash fill factor (records per bucket)" << std::endl;
+        std::cout << "         --shared           Share the environment with concurrent processes" << std::endl;
+        std::cout << "         --snapshot         Share the environment with snapshot reads (multiversion)" << std::endl;
+        std::cout << "         --writer           Run a writer process next to the benchmark readers" << std::endl;
+        std::cout << "         --storage engine   Storage engine: bdb (default), memory or mmap" << std::endl;
+        std::cout << "         --partitions n     Split the database into n files by key hash" << std::endl;
+        std::cout << "         --partition-dirs d1,d2,...  Directories the partitions go to, round robin" << std::endl;
         std::exit(1);
     }
 
+    if (args[2] == "--bench-readers") {
+        // Stored matrix is read by forked processes on a shared environment
+        try {
+            benchmarkReaders(args[1], std::max(1, std::stoi(args[3])), argCount > 4 ? std::stod(args[4]) : 2, writer,
+                             options.snapshot);
+        } catch (std::exception& e) {
+            std::cout << "Error: Invalid arguments" << std::endl;
+            std::exit(1);
+        }
+        return 0;
+    }
+
+    bool import = args[2] == "--import";
+    bool open = args[2] == "--open";
+    int n = 0;
+    if (!import && !open) {
+        try {
+            n = std::stoi(args[2]);
+        } catch (std::exception& e) {
+            std::cout << "Error: Invalid arguments" << std::endl;
+            std::exit(1);
+        }
+    }
+    const int exportArg = import ? 4 : 3; // Index of optional export file
+
     timeval start;
     gettimeofday(&start, nullptr);
 
     std::srand(std::time(nullptr));
-    Matrix* matrix = new Matrix(argv[1], n);
+    Matrix* matrix;
+    if (open) {
+        matrix = new Matrix(args[1], options); // Reuse matrix stored by an earlier run
+    } else if (import) {
+        matrix = new Matrix(args[1], args[3], options);
+    } else {
+        matrix = new Matrix(args[1], n, options);
+    }
     matrix->print();
+    if (argCount > exportArg) {
+        matrix->exportTo(args[exportArg]); // CSV, or raw binary for .bin
+    }
     std::cout << "\nInfinity Norm of matrix: " << matrix->computeInfinityNorm() << std::endl;
+    std::cout << "2-Norm of matrix (estimate): " << matrix->estimateSpectralNorm() << std::endl;
+    matrix->printPageReport();
     delete matrix;
 
     timeval elapsed;
@@ -0,0 +1,203 @@
+#ifndef BDB_STORAGE_H
+#define BDB_STORAGE_H
+
+#include <cstdint>
+#include <cstdlib> // exit, free
+#include <db_cxx.h> // Berkeley DB
+#include <exception>
+#include <iostream>
+#include <string>
+
+#include "storage.h"
+
+// Page geometry of a hash database, which only applies when the database
+// file is created (an existing file keeps its own), and environment mode.
+struct BdbOptions {
+    u_int32_t pageSize = 0; // Bytes, power of two in [512, 65536], 0 = Berkeley DB default
+    u_int32_t fillFactor = 0; // Target records per bucket, 0 = chosen as pages fill
+    u_int32_t expectedRecords = 0; // Final record count (nelem), 0 = unknown
+    // Share ./db with other processes: Concurrent Data Store locking lets
+    // any number of readers work alongside one writer. Every process
+    // using the environment must set it.
+    bool shared = false;
+    // Share ./db as a transactional environment with multiversion pages
+    // instead: readers in a snapshot never wait for the writer and the
+    // writer never waits for them. Every process must set it, and it
+    // overrides shared.
+    bool snapshot = false;
+    std::string home = "./db"; // Environment directory, must exist
+};
+
+// Berkeley DB hash database in the environment directory (./db), the
+// reference storage engine. The handles are opened with DB_THREAD, so one
+// thread may read while another writes.
+class BdbStorage : public Storage {
+  private:
+    DbEnv* mEnv; // Berkeley DB environment variable
+    Db* mDatabase; // Berkeley DB connection
+    std::string dbName;
+    bool mMultiversion; // Opened for snapshot reads
+    DbTxn* mSnapshot; // Snapshot gets read in, or nullptr
+
+  public:
+    BdbStorage(const std::string dbName, const BdbOptions& options);
+    ~BdbStorage();
+
+    bool get(const void* key, size_t keySize, void* value, size_t size) override;
+    void put(const void* key, size_t keySize, const void* value, size_t size) override;
+    void remove(const void* key, size_t keySize) override;
+    void sync() override;
+    void printReport() override; // Page counts and fill from Db::stat
+    void beginSnapshot() override; // Snapshot transaction, when opened for snapshot reads
+    void endSnapshot() override;
+};
+
+inline BdbStorage::BdbStorage(const std::string dbName, const BdbOptions& options)
+    : mEnv(nullptr), mDatabase(nullptr), dbName(dbName), mMultiversion(options.snapshot), mSnapshot(nullptr) {
+    mEnv = new DbEnv(0); // Berkeley DB Environment
+    mEnv->set_error_stream(&std::cerr); // Set error stream
+    // Allocate cache memory. Copies of pages changed under a snapshot
+    // are kept in the cache, so a multiversion environment needs more.
+    mEnv->set_cachesize(0, mMultiversion ? 1024 * 1024 : 64 * 1024, 0);
+
+    u_int32_t dbFlags = DB_CREATE | DB_THREAD;
+    try {
+        // Regions, including the cache, are memory-mapped files in ./db, so
+        // processes sharing the environment share one cache
+        u_int32_t flags = DB_CREATE | DB_INIT_MPOOL | DB_THREAD;
+        if (mMultiversion) {
+            // Puts outside a transaction commit on their own
+            flags |= DB_INIT_TXN | DB_INIT_LOCK | DB_INIT_LOG;
+            dbFlags |= DB_MULTIVERSION;
+            mEnv->set_flags(DB_AUTO_COMMIT, 1);
+            mEnv->set_lk_detect(DB_LOCK_DEFAULT); // Break deadlocks between writers
+        } else if (options.shared) {
+            flags |= DB_INIT_CDB;
+        }
+        mEnv->open(options.home.c_str(), flags, 0); // Open environment
+    } catch (const DbException& e) {
+        std::cerr << "Error: Unable to open db.\n";
+        std::cerr << e.what() << std::endl;
+        std::exit(1);
+    } catch (const std::exception& e) {
+        std::cerr << "Error: Unable to create environment.\n";
+        std::cerr << e.what() << std::endl;
+        std::exit(1);
+    }
+
+    try {
+        mDatabase = new Db(mEnv, 0); // Database
+        if (options.pageSize > 0) {
+            mDatabase->set_pagesize(options.pageSize);
+        }
+        if (options.fillFactor > 0) {
+            mDatabase->set_h_ffactor(options.fillFactor);
+        }
+        if (options.expectedRecords > 0) {
+            mDatabase->set_h_nelem(options.expectedRecords); // Presize the bucket array
+        }
+        // Open the database
+        mDatabase->open(nullptr, (dbName + ".db").c_str(), nullptr, DB_HASH, dbFlags, 0);
+    } catch (const DbException& e) {
+        std::cerr << "Error opening database.\n";
+        std::cerr << e.what() << std::endl;
+        std::exit(1);
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        std::exit(1);
+    }
+}
+
+inline BdbStorage::~BdbStorage() {
+    endSnapshot();
+    mDatabase->close(0); // Close the database
+    mEnv->close(0); // Close the environment
+
+    delete mDatabase;
+    delete mEnv;
+}
+
+inline bool BdbStorage::get(const void* key, size_t keySize, void* value, size_t size) {
+    Dbt k(const_cast<void*>(key), keySize);
+    Dbt v(value, size); // Free-threaded handles return into memory of the caller
+    v.set_ulen(size);
+    v.set_flags(DB_DBT_USERMEM);
+
+    try {
+        return this->mDatabase->get(mSnapshot, &k, &v, 0) != DB_NOTFOUND && v.get_size() == size;
+    } catch (const DbMemoryException&) {
+        return false; // Value larger than size
+    }
+}
+
+inline void BdbStorage::put(const void* key, size_t keySize, const void* value, size_t size) {
+    Dbt k(const_cast<void*>(key), keySize);
+    Dbt v(const_cast<void*>(value), size);
+
+    // An auto-commit put that loses a deadlock to another writer is rolled
+    // back, so it is simply retried
+    for (;;) {
+        try {
+            if (this->mDatabase->put(nullptr, &k, &v, 0) != DB_LOCK_DEADLOCK) { // Set/update value
+                return;
+            }
+        } catch (const DbDeadlockException&) {
+        }
+    }
+}
+
+inline void BdbStorage::remove(const void* key, size_t keySize) {
+    Dbt k(const_cast<void*>(key), keySize);
+    for (;;) { // Retried like put
+        try {
+            if (this->mDatabase->del(nullptr, &k, 0) != DB_LOCK_DEADLOCK) {
+                return;
+            }
+        } catch (const DbDeadlockException&) {
+        }
+    }
+}
+
+inline void BdbStorage::sync() {
+    this->mDatabase->sync(0);
+}
+
+inline void BdbStorage::beginSnapshot() {
+    if (!mMultiversion || mSnapshot != nullptr) {
+        return;
+    }
+
+    try {
+        mEnv->txn_begin(nullptr, &mSnapshot, DB_TXN_SNAPSHOT);
+    } catch (const DbException& e) {
+        std::cerr << "Error beginning snapshot.\n";
+        std::cerr << e.what() << std::endl;
+        std::exit(1);
+    }
+}
+
+inline void BdbStorage::endSnapshot() {
+    if (mSnapshot != nullptr) {
+        mSnapshot->commit(0); // Read-only, releases the page versions it pinned
+        mSnapshot = nullptr;
+    }
+}
+
+// Utilization of bucket, overflow and big-item pages. The full stat reads
+// every page, so this is for after a load, not for the hot path.
+inline void BdbStorage::printReport() {
+    DB_HASH_STAT* stat;
+    this->mDatabase->stat(nullptr, &stat, 0);
+
+    uintmax_t pages = uintmax_t(stat->hash_buckets) + stat->hash_overflows + stat->hash_bigpages;
+    uintmax_t freeBytes = stat->hash_bfree + stat->hash_ovfl_free + stat->hash_big_bfree;
+    double fill = pages > 0 ? 100.0 * (pages * stat->hash_pagesize - freeBytes) / (pages * stat->hash_pagesize) : 0;
+    std::cout << "Pages of " << dbName << ": " << stat->hash_pagecnt << " x " << stat->hash_pagesize << " bytes, "
+              << stat->hash_buckets << " buckets, " << stat->hash_overflows << " overflow, " << stat->hash_bigpages
+              << " big item, fill factor " << stat->hash_ffactor << ", " << stat->hash_ndata << " records, "
+              << fill << "% full\n";
+
+    std::free(stat); // Allocated by Berkeley DB
+}
+
+#endif
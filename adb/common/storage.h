@@ -0,0 +1,351 @@
+#ifndef STORAGE_H
+#define STORAGE_H
+
+#include <cstdint>
+#include <cstdlib> // exit
+#include <cstring> // memcpy
+#include <fcntl.h> // open
+#include <iostream>
+#include <string>
+#include <sys/mman.h> // mmap, msync, munmap
+#include <sys/stat.h> // fstat
+#include <unistd.h> // ftruncate, close
+#include <unordered_map>
+#include <vector>
+
+// Key-value storage engines a Database can run on. Berkeley DB is the
+// reference; the others exist to measure how much of a workload's time is
+// spent in the storage engine.
+enum class StorageEngine {
+    BDB, // Berkeley DB database in ./db
+    MEMORY, // Hash table in process memory, gone at exit
+    MMAP // Memory-mapped flat file in ./db
+};
+
+// Parse "bdb", "memory" or "mmap". Returns false for other names.
+inline bool parseStorageEngine(const std::string& name, StorageEngine& engine) {
+    if (name == "bdb") {
+        engine = StorageEngine::BDB;
+    } else if (name == "memory") {
+        engine = StorageEngine::MEMORY;
+    } else if (name == "mmap") {
+        engine = StorageEngine::MMAP;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+// Byte-oriented key-value store. Values are fixed-size records read back
+// with the size they were written with.
+class Storage {
+  public:
+    virtual ~Storage() {}
+
+    // Copy the value of key into value. False if key is missing or its
+    // value is not size bytes.
+    virtual bool get(const void* key, size_t keySize, void* value, size_t size) = 0;
+    virtual void put(const void* key, size_t keySize, const void* value, size_t size) = 0; // Set/update value
+    virtual void remove(const void* key, size_t keySize) = 0;
+    virtual void sync() = 0; // Make writes durable
+    virtual void printReport() = 0; // Records and space used
+
+    // Gets until endSnapshot() see the records as of beginSnapshot(),
+    // where the engine keeps versions; otherwise they see the latest.
+    virtual void beginSnapshot() {}
+    virtual void endSnapshot() {}
+};
+
+// Hash table in memory. Nothing is persisted.
+class MemoryStorage : public Storage {
+  private:
+    std::string mName;
+    std::unordered_map<std::string, std::string> mRecords;
+
+  public:
+    MemoryStorage(const std::string& name) : mName(name) {}
+
+    bool get(const void* key, size_t keySize, void* value, size_t size) override;
+    void put(const void* key, size_t keySize, const void* value, size_t size) override;
+    void remove(const void* key, size_t keySize) override;
+    void sync() override {}
+    void printReport() override;
+};
+
+inline bool MemoryStorage::get(const void* key, size_t keySize, void* value, size_t size) {
+    auto it = mRecords.find(std::string(static_cast<const char*>(key), keySize));
+    if (it == mRecords.end() || it->second.size() != size) {
+        return false;
+    }
+    std::memcpy(value, it->second.data(), size);
+    return true;
+}
+
+inline void MemoryStorage::put(const void* key, size_t keySize, const void* value, size_t size) {
+    mRecords[std::string(static_cast<const char*>(key), keySize)].assign(static_cast<const char*>(value), size);
+}
+
+inline void MemoryStorage::remove(const void* key, size_t keySize) {
+    mRecords.erase(std::string(static_cast<const char*>(key), keySize));
+}
+
+inline void MemoryStorage::printReport() {
+    size_t bytes = 0;
+    for (const auto& record : mRecords) {
+        bytes += record.first.size() + record.second.size();
+    }
+    std::cout << "Storage of " << mName << ": memory, " << mRecords.size() << " records, " << bytes
+              << " bytes of keys and values\n";
+}
+
+// Append-only record file mapped into memory. Reads are a hash lookup and
+// a memcpy from the mapping; a value rewritten with the same size is
+// updated in place, otherwise the old record is marked deleted and a new
+// one appended. The index of record offsets is rebuilt by scanning the
+// file on open.
+class MmapStorage : public Storage {
+  private:
+    struct FileHeader {
+        uint64_t magic;
+        uint64_t used; // Bytes of file in use, header included
+    };
+
+    // Followed by the key and the value, padded to 8 bytes
+    struct RecordHeader {
+        uint32_t keySize;
+        uint32_t valueSize; // DELETED bit set once superseded
+    };
+
+    static constexpr uint64_t MAGIC = 0x50414d4d42444141ULL; // "AADBMMAP"
+    static constexpr uint32_t DELETED = 0x80000000u;
+    static constexpr size_t INITIAL_CAPACITY = 1 << 20;
+
+    std::string mPath;
+    int mFd;
+    char* mData; // Mapping of the whole file
+    size_t mCapacity; // File and mapping size
+    size_t mLive; // Bytes of records not deleted
+    std::unordered_map<std::string, size_t> mIndex; // Key to record offset
+
+    FileHeader* header() { return reinterpret_cast<FileHeader*>(mData); }
+    RecordHeader* record(size_t offset) { return reinterpret_cast<RecordHeader*>(mData + offset); }
+    static size_t recordSize(size_t keySize, size_t valueSize) {
+        return (sizeof(RecordHeader) + keySize + valueSize + 7) & ~size_t(7);
+    }
+
+    void map(size_t capacity);
+    void markDeleted(size_t offset);
+
+  public:
+    MmapStorage(const std::string& path);
+    ~MmapStorage();
+
+    bool get(const void* key, size_t keySize, void* value, size_t size) override;
+    void put(const void* key, size_t keySize, const void* value, size_t size) override;
+    void remove(const void* key, size_t keySize) override;
+    void sync() override;
+    void printReport() override;
+};
+
+inline MmapStorage::MmapStorage(const std::string& path)
+    : mPath(path), mFd(-1), mData(nullptr), mCapacity(0), mLive(0) {
+    mFd = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+    struct stat st;
+    if (mFd < 0 || fstat(mFd, &st) != 0) {
+        std::cerr << "Error: Unable to open " << path << ".\n";
+        std::exit(1);
+    }
+
+    bool created = static_cast<size_t>(st.st_size) < sizeof(FileHeader);
+    map(created ? INITIAL_CAPACITY : st.st_size);
+    if (created) {
+        header()->magic = MAGIC;
+        header()->used = sizeof(FileHeader);
+    } else if (header()->magic != MAGIC || header()->used > mCapacity) {
+        std::cerr << "Error: " << path << " is not a storage file.\n";
+        std::exit(1);
+    }
+
+    for (size_t offset = sizeof(FileHeader); offset < header()->used;) {
+        RecordHeader* r = record(offset);
+        if ((r->valueSize & DELETED) == 0) {
+            mIndex[std::string(mData + offset + sizeof(RecordHeader), r->keySize)] = offset;
+            mLive += recordSize(r->keySize, r->valueSize);
+        }
+        offset += recordSize(r->keySize, r->valueSize & ~DELETED);
+    }
+}
+
+inline MmapStorage::~MmapStorage() {
+    munmap(mData, mCapacity);
+    ::close(mFd);
+}
+
+// (Re)map the file at the given size, growing the file if needed
+inline void MmapStorage::map(size_t capacity) {
+    if (mData != nullptr) {
+        munmap(mData, mCapacity);
+    }
+    if (ftruncate(mFd, capacity) != 0) {
+        std::cerr << "Error: Unable to grow " << mPath << ".\n";
+        std::exit(1);
+    }
+    void* data = mmap(nullptr, capacity, PROT_READ | PROT_WRITE, MAP_SHARED, mFd, 0);
+    if (data == MAP_FAILED) {
+        std::cerr << "Error: Unable to map " << mPath << ".\n";
+        std::exit(1);
+    }
+    mData = static_cast<char*>(data);
+    mCapacity = capacity;
+}
+
+inline void MmapStorage::markDeleted(size_t offset) {
+    RecordHeader* r = record(offset);
+    mLive -= recordSize(r->keySize, r->valueSize);
+    r->valueSize |= DELETED;
+}
+
+inline bool MmapStorage::get(const void* key, size_t keySize, void* value, size_t size) {
+    auto it = mIndex.find(std::string(static_cast<const char*>(key), keySize));
+    if (it == mIndex.end() || record(it->second)->valueSize != size) {
+        return false;
+    }
+    std::memcpy(value, mData + it->second + sizeof(RecordHeader) + keySize, size);
+    return true;
+}
+
+inline void MmapStorage::put(const void* key, size_t keySize, const void* value, size_t size) {
+    std::string k(static_cast<const char*>(key), keySize);
+    auto it = mIndex.find(k);
+    if (it != mIndex.end()) {
+        if (record(it->second)->valueSize == size) {
+            std::memcpy(mData + it->second + sizeof(RecordHeader) + keySize, value, size);
+            return;
+        }
+        markDeleted(it->second);
+    }
+
+    size_t offset = header()->used;
+    size_t length = recordSize(keySize, size);
+    if (offset + length > mCapacity) {
+        size_t capacity = mCapacity;
+        while (offset + length > capacity) {
+            capacity *= 2;
+        }
+        map(capacity);
+    }
+
+    RecordHeader* r = record(offset);
+    r->keySize = keySize;
+    r->valueSize = size;
+    std::memcpy(mData + offset + sizeof(RecordHeader), key, keySize);
+    std::memcpy(mData + offset + sizeof(RecordHeader) + keySize, value, size);
+    header()->used = offset + length; // Record is complete before it is counted
+    mIndex[k] = offset;
+    mLive += length;
+}
+
+inline void MmapStorage::remove(const void* key, size_t keySize) {
+    auto it = mIndex.find(std::string(static_cast<const char*>(key), keySize));
+    if (it != mIndex.end()) {
+        markDeleted(it->second);
+        mIndex.erase(it);
+    }
+}
+
+inline void MmapStorage::sync() {
+    msync(mData, header()->used, MS_SYNC);
+}
+
+inline void MmapStorage::printReport() {
+    size_t used = header()->used;
+    std::cout << "Storage of " << mPath << ": mmap, " << mIndex.size() << " records, " << used << " of " << mCapacity
+              << " bytes used, " << (used > 0 ? 100.0 * mLive / used : 0) << "% live\n";
+}
+
+// Records spread over several storages by a hash of the key, so that
+// every partition is its own file (and, placed in different directories,
+// its own disk) with its own pages and cache. Routing keeps no state:
+// threads working on keys of different partitions share nothing.
+class PartitionedStorage : public Storage {
+  private:
+    std::vector<Storage*> mPartitions;
+
+    Storage* partition(const void* key, size_t keySize) const;
+
+  public:
+    PartitionedStorage(const std::vector<Storage*>& partitions) : mPartitions(partitions) {}
+    ~PartitionedStorage();
+
+    size_t partitionCount() const { return mPartitions.size(); }
+    size_t partitionOf(const void* key, size_t keySize) const; // Index of the partition holding key
+
+    bool get(const void* key, size_t keySize, void* value, size_t size) override;
+    void put(const void* key, size_t keySize, const void* value, size_t size) override;
+    void remove(const void* key, size_t keySize) override;
+    void sync() override;
+    void printReport() override;
+    void beginSnapshot() override;
+    void endSnapshot() override;
+};
+
+inline PartitionedStorage::~PartitionedStorage() {
+    for (Storage* p : mPartitions) {
+        delete p;
+    }
+}
+
+// FNV-1a of the key bytes. The partition of a key must never change, or
+// reopened databases would miss their records.
+inline size_t PartitionedStorage::partitionOf(const void* key, size_t keySize) const {
+    const unsigned char* bytes = static_cast<const unsigned char*>(key);
+    uint64_t hash = 14695981039346656037ULL;
+    for (size_t i = 0; i < keySize; ++i) {
+        hash = (hash ^ bytes[i]) * 1099511628211ULL;
+    }
+    return (hash ^ (hash >> 32)) % mPartitions.size();
+}
+
+inline Storage* PartitionedStorage::partition(const void* key, size_t keySize) const {
+    return mPartitions[partitionOf(key, keySize)];
+}
+
+inline bool PartitionedStorage::get(const void* key, size_t keySize, void* value, size_t size) {
+    return partition(key, keySize)->get(key, keySize, value, size);
+}
+
+inline void PartitionedStorage::put(const void* key, size_t keySize, const void* value, size_t size) {
+    partition(key, keySize)->put(key, keySize, value, size);
+}
+
+inline void PartitionedStorage::remove(const void* key, size_t keySize) {
+    partition(key, keySize)->remove(key, keySize);
+}
+
+inline void PartitionedStorage::sync() {
+    for (Storage* p : mPartitions) {
+        p->sync();
+    }
+}
+
+inline void PartitionedStorage::printReport() {
+    for (Storage* p : mPartitions) {
+        p->printReport();
+    }
+}
+
+// Snapshots are taken per partition, one after the other, so they are
+// only consistent across partitions while no writer runs in between
+inline void PartitionedStorage::beginSnapshot() {
+    for (Storage* p : mPartitions) {
+        p->beginSnapshot();
+    }
+}
+
+inline void PartitionedStorage::endSnapshot() {
+    for (Storage* p : mPartitions) {
+        p->endSnapshot();
+    }
+}
+
+#endif
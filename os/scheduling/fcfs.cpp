@@ -2,15 +2,17 @@
 #include <iostream>
 #include <vector>
 
+#include "trace.h"
+
 // Process structure
 struct Process {
     int pid;
     int arrivalTime;
     int executionTime;
-    int startingTime;
-    int finishedTime;
-    int waitingTime;
-    int turnAroundTime;
+    long long startingTime;
+    long long finishedTime;
+    long long waitingTime;
+    long long turnAroundTime;
 };
 
 // Method to compare two proces for sorting purpose.
@@ -23,45 +25,72 @@ bool processCompare(Process& p1, Process& p2) {
 
 class FCFS {
   private:
-    int mTimer;
+    long long mTimer;
     std::vector<Process> mProcessQueue;
+    TraceReader* mTrace; // Jobs streamed from a trace, or nullptr
+    ScheduleStats mStats; // Of streamed jobs, which are not kept
+
+    void run(Process&);
 
   public:
     FCFS(std::vector<Process>&);
+    FCFS(TraceReader&);
     void process();
     void print();
     void printGanttChart();
 };
 
 // FCFS constructor
-FCFS::FCFS(std::vector<Process>& processes) : mTimer{0}, mProcessQueue{processes} {
+FCFS::FCFS(std::vector<Process>& processes) : mTimer{0}, mProcessQueue{processes}, mTrace{nullptr} {
     // Sort the processes based on arrival time and pid.
     std::sort(mProcessQueue.begin(), mProcessQueue.end(), processCompare);
 }
 
+// Jobs of a trace are already in arrival order and read one at a time.
+FCFS::FCFS(TraceReader& trace) : mTimer{0}, mTrace{&trace} {}
+
+void FCFS::run(Process& process) {
+    // Update timer if it is running behing arrival of current process.
+    if (mTimer < process.arrivalTime)
+        mTimer = process.arrivalTime;
+
+    process.startingTime = mTimer; // Start the process
+    mTimer += process.executionTime;
+    process.finishedTime = mTimer; // Stop the process
+
+    // Turn around time.
+    process.turnAroundTime = process.finishedTime - process.arrivalTime;
+    // Waiting time.
+    process.waitingTime = process.turnAroundTime - process.executionTime;
+}
+
 void FCFS::process() {
+    if (mTrace != nullptr) {
+        TraceJob job;
+        while (mTrace->next(job)) {
+            Process process = {job.pid, job.arrivalTime, job.burstTime};
+            run(process);
+            mStats.add(process.arrivalTime, process.executionTime, process.finishedTime);
+        }
+        return;
+    }
+
     for (auto& process : mProcessQueue) {
-        // Update timer if it is running behing arrival of current process.
-        if (mTimer < process.arrivalTime)
-            mTimer = process.arrivalTime;
-
-        process.startingTime = mTimer; // Start the process
-        mTimer += process.executionTime;
-        process.finishedTime = mTimer; // Stop the process
-
-        // Turn around time.
-        process.turnAroundTime = process.finishedTime - process.arrivalTime;
-        // Waiting time.
-        process.waitingTime = process.turnAroundTime - process.executionTime;
+        run(process);
     }
 }
 
 void FCFS::print() {
     process();
+    if (mTrace != nullptr) {
+        mStats.print(); // Summary only, a trace is too long for a table
+        return;
+    }
+
     std::cout << "P\tAT\tBT\tST\tFT\tWT\tTAT\n";
 
-    int waitingTime = 0;
-    int turnAroundTime = 0;
+    long long waitingTime = 0;
+    long long turnAroundTime = 0;
     for (auto& process : mProcessQueue) {
         std::cout << process.pid << '\t';
         std::cout << process.arrivalTime << '\t';
@@ -101,6 +130,12 @@ void FCFS::printGanttChart() {
 // Main function
 //----------------------------------------------------------------
 int main(int argc, char* argv[]) {
+    if (const char* path = traceArgument(argc, argv)) {
+        TraceReader trace(path);
+        FCFS(trace).print();
+        return 0;
+    }
+
     std::vector<Process> processList = {
         // pid, arrival, execution
         {0,  0, 5},
@@ -5,16 +5,18 @@
 #include <utility>
 #include <vector>
 
+#include "trace.h"
+
 // Process structure
 struct Process {
     int pid;
     int arrivalTime;
     int burstTime;
     int tempBurstTime;
-    int startingTime;
-    int finishingTime;
-    int turnAroundTime;
-    int waitingTime;
+    long long startingTime;
+    long long finishingTime;
+    long long turnAroundTime;
+    long long waitingTime;
     bool init;
 };
 
@@ -27,14 +29,22 @@ class RoundRobin {
     std::queue<Process> mProcessList; // Initially store all processes in queue.
     // Store running processes.
     std::queue<Process> mRunningProcessList;
-    std::vector<std::pair<int, int>> mGantChart; // <pid, time>
+    std::vector<std::pair<int, long long>> mGantChart; // <pid, time>
     std::vector<Process> mFinishedProcesses;
 
-    int mTimeCounter; // Running time counter.
+    long long mTimeCounter; // Running time counter.
     int mTimeQuantum; // Time limit for each process.
 
+    TraceReader* mTrace; // Jobs streamed from a trace, or nullptr
+    ScheduleStats mStats; // Of streamed jobs, which are not kept
+
+    bool pending();
+    long long timeUntil(long long time); // Time from now to the first quantum boundary at or after time
+    void addGanttEntry(int pid, long long sliceEnd);
+
   public:
     RoundRobin(std::vector<Process>&);
+    RoundRobin(TraceReader&);
     void scheduleProcess();
     void print();
     void printGanttChart();
@@ -52,55 +62,109 @@ RoundRobin::RoundRobin(std::vector<Process>& processList) {
 
     mTimeCounter = 0;
     mTimeQuantum = 1; // 1 second.
+    mTrace = nullptr;
+}
+
+RoundRobin::RoundRobin(TraceReader& trace) {
+    mTimeCounter = 0;
+    mTimeQuantum = 1; // 1 second.
+    mTrace = &trace;
+}
+
+// True if a process is still to arrive, which is then the front of
+// mProcessList. Jobs of a trace are read one at a time, when the schedule
+// reaches them.
+bool RoundRobin::pending() {
+    TraceJob job;
+    if (mProcessList.empty() && mTrace != nullptr && mTrace->next(job)) {
+        Process process = {};
+        process.pid = job.pid;
+        process.arrivalTime = job.arrivalTime;
+        process.burstTime = job.burstTime;
+        process.tempBurstTime = job.burstTime;
+        mProcessList.push(process);
+    }
+    return !mProcessList.empty();
+}
+
+// Processes are only picked at quantum boundaries, so a process arriving
+// at time waits for the first boundary at or after it.
+long long RoundRobin::timeUntil(long long time) {
+    long long quanta = std::max<long long>(1, (time - mTimeCounter + mTimeQuantum - 1) / mTimeQuantum);
+    return quanta * mTimeQuantum;
+}
+
+// A slice continuing the previous one, of the same process without a
+// gap, is not a new entry.
+void RoundRobin::addGanttEntry(int pid, long long sliceEnd) {
+    if (mTrace != nullptr) {
+        return; // Not kept for a trace
+    }
+    if (mGantChart.empty() || mGantChart.back().first != pid || sliceEnd != mTimeCounter) {
+        mGantChart.push_back({pid, mTimeCounter});
+    }
 }
 
 void RoundRobin::scheduleProcess() {
+    // Event driven: time jumps straight to the next arrival, quantum expiry
+    // or completion, so the cost grows with the number of events, not with
+    // the time simulated.
+    long long sliceEnd = -1; // End of the previous slice
     // Keep scheduling until all processes are processed.
-    while (!mProcessList.empty() || !mRunningProcessList.empty()) {
+    while (pending() || !mRunningProcessList.empty()) {
+        // Nothing to run, skip to the next arrival.
+        if (mRunningProcessList.empty() && mTimeCounter < mProcessList.front().arrivalTime) {
+            mTimeCounter = mProcessList.front().arrivalTime;
+        }
+
         // If arrivalTime is less than mTimeCounter then load process into running Queue.
-        while (!mProcessList.empty() && mTimeCounter >= mProcessList.front().arrivalTime) {
+        while (pending() && mTimeCounter >= mProcessList.front().arrivalTime) {
             mRunningProcessList.push(mProcessList.front());
             mProcessList.pop();
         }
 
-        if (!mRunningProcessList.empty()) {
-            // Fetch least burst time process into currentProcess
-            Process currentProcess = mRunningProcessList.front();
-            mRunningProcessList.pop();
+        // Fetch the process at the front of the queue into currentProcess
+        Process currentProcess = mRunningProcessList.front();
+        mRunningProcessList.pop();
 
-            // Update starting time if required
-            if (currentProcess.init == false) {
-                currentProcess.startingTime = mTimeCounter;
-                currentProcess.init = true;
+        // Update starting time if required
+        if (currentProcess.init == false) {
+            currentProcess.startingTime = mTimeCounter;
+            currentProcess.init = true;
+        }
+        addGanttEntry(currentProcess.pid, sliceEnd); // Push process to gant chart.
+
+        // Process for a time quantum. With no other process waiting, the
+        // quantum expiries before the next arrival change nothing, so it
+        // keeps running until then.
+        long long runTime = std::min(currentProcess.tempBurstTime, mTimeQuantum);
+        if (mRunningProcessList.empty()) {
+            runTime = currentProcess.tempBurstTime;
+            if (pending()) {
+                runTime = std::min(runTime, timeUntil(mProcessList.front().arrivalTime));
             }
-            mGantChart.push_back({currentProcess.pid, mTimeCounter}); // Push process to gant chart.
-
-            if (currentProcess.tempBurstTime < mTimeQuantum) {
-                mTimeCounter += currentProcess.tempBurstTime;
-                currentProcess.tempBurstTime = 0;
+        }
+        currentProcess.tempBurstTime -= runTime;
+        mTimeCounter += runTime;
+        sliceEnd = mTimeCounter;
+
+        if (currentProcess.tempBurstTime == 0) {
+            currentProcess.finishingTime = mTimeCounter; // Update finishing time.
+            if (mTrace != nullptr) {
+                mStats.add(currentProcess.arrivalTime, currentProcess.burstTime, currentProcess.finishingTime);
             } else {
-                currentProcess.tempBurstTime -= mTimeQuantum; // Process for time quantum.
-                mTimeCounter += mTimeQuantum;
-            }
-
-            if (currentProcess.tempBurstTime == 0) {
-                currentProcess.finishingTime = mTimeCounter; // Update finishing time.
                 mFinishedProcesses.push_back(currentProcess);
-            } else {
-                // Add all the processes to the process list which
-                // comes during the processing of the current process.
-                for (int i = mTimeCounter - mTimeQuantum; i <= mTimeCounter; ++i) {
-                    if (!mProcessList.empty() && i >= mProcessList.front().arrivalTime) {
-                        mRunningProcessList.push(mProcessList.front());
-                        mProcessList.pop();
-                    }
-                }
-
-                // Push current process at the end of the queue.
-                mRunningProcessList.push(currentProcess);
             }
         } else {
-            mTimeCounter += mTimeQuantum;
+            // Add all the processes to the process list which
+            // comes during the processing of the current process.
+            while (pending() && mTimeCounter >= mProcessList.front().arrivalTime) {
+                mRunningProcessList.push(mProcessList.front());
+                mProcessList.pop();
+            }
+
+            // Push current process at the end of the queue.
+            mRunningProcessList.push(currentProcess);
         }
     }
 
@@ -113,10 +177,15 @@ void RoundRobin::scheduleProcess() {
 
 void RoundRobin::print() {
     scheduleProcess();
+    if (mTrace != nullptr) {
+        mStats.print(); // Summary only, a trace is too long for a table
+        return;
+    }
+
     std::cout << "P\tAT\tBT\tST\tFT\tTAT\tWT\n";
 
-    int waitingTime = 0;
-    int turnAroundTime = 0;
+    long long waitingTime = 0;
+    long long turnAroundTime = 0;
     for (auto& p : mFinishedProcesses) {
         std::cout << p.pid << '\t';
         std::cout << p.arrivalTime << '\t';
@@ -153,7 +222,13 @@ void RoundRobin::printGanttChart() {
     std::cout << std::endl;
 }
 
-int main() {
+int main(int argc, char* argv[]) {
+    if (const char* path = traceArgument(argc, argv)) {
+        TraceReader trace(path);
+        RoundRobin(trace).print();
+        return 0;
+    }
+
     // std::vector<Process> processList = {
     //     // pid, arrival time, burst time
     //     {1, 0, 4, 4},
@@ -1,10 +1,13 @@
 #include <algorithm>
 #include <deque>
 #include <iostream>
+#include <map>
 #include <queue>
 #include <utility>
 #include <vector>
 
+#include "trace.h"
+
 // Process structure
 struct Process {
     int pid;
@@ -12,10 +15,10 @@ struct Process {
     int priority;
     int burstTime;
     int tempBurstTime;
-    int startingTime;
-    int finishingTime;
-    int turnAroundTime;
-    int waitingTime;
+    long long startingTime;
+    long long finishingTime;
+    long long turnAroundTime;
+    long long waitingTime;
     bool init;
 };
 
@@ -36,8 +39,10 @@ bool compare(Process& p1, Process& p2) {
 // useful functionalities.
 class RunningProcess {
   private:
-    // Index of the vector is priority.
-    std::vector<std::queue<Process>> mProcessList;
+    // Queue of each priority with a waiting process, highest priority
+    // (lowest number) first. Keyed by priority, so sparse or large
+    // priorities cost nothing.
+    std::map<int, std::queue<Process>> mProcessList;
     int processCount;
 
   public:
@@ -52,30 +57,31 @@ class RunningProcess {
     }
 
     int addProcess(Process& process) {
-        while (process.priority >= mProcessList.size()) {
-            // If size of vector is less than the process.priority
-            // then increase vector size.
-            mProcessList.push_back(std::queue<Process>());
-        }
-
         // Add the process to the list.
         mProcessList[process.priority].push(process);
         return ++processCount;
     }
 
+    // True if a process of this or a higher priority is waiting.
+    bool hasProcess(int priority) {
+        return !mProcessList.empty() && mProcessList.begin()->first <= priority;
+    }
+
     // Returns the higest priority process.
     Process getProcess() {
-        for (auto& processList : mProcessList) {
-            if (processList.size() > 0) {
-                Process& process = processList.front();
-                processList.pop();
+        if (mProcessList.empty()) {
+            return Process(); // Return empty process.
+        }
 
-                --processCount;
-                return process;
-            }
+        auto processList = mProcessList.begin();
+        Process process = processList->second.front();
+        processList->second.pop();
+        if (processList->second.empty()) {
+            mProcessList.erase(processList);
         }
 
-        return Process(); // Return empty process.
+        --processCount;
+        return process;
     }
 };
 
@@ -84,14 +90,22 @@ class PriorityPreemptive {
     std::queue<Process> mProcessList; // Initially store all processes in queue.
     // Store running processes.
     RunningProcess mRunningProcessList;
-    std::vector<std::pair<int, int>> mGantChart; // <pid, time>
+    std::vector<std::pair<int, long long>> mGantChart; // <pid, time>
     std::vector<Process> mFinishedProcesses;
 
-    int mTimeCounter; // Running time counter.
+    long long mTimeCounter; // Running time counter.
     int mTimeQuantum; // Time limit for each process.
 
+    TraceReader* mTrace; // Jobs streamed from a trace, or nullptr
+    ScheduleStats mStats; // Of streamed jobs, which are not kept
+
+    bool pending();
+    long long timeUntil(long long time); // Time from now to the first quantum boundary at or after time
+    void addGanttEntry(int pid, long long sliceEnd);
+
   public:
     PriorityPreemptive(std::vector<Process>&);
+    PriorityPreemptive(TraceReader&);
     void scheduleProcess();
     void print();
     void printGanttChart();
@@ -109,53 +123,108 @@ PriorityPreemptive::PriorityPreemptive(std::vector<Process>& processList) {
 
     mTimeCounter = 0;
     mTimeQuantum = 1; // 1 second.
+    mTrace = nullptr;
+}
+
+PriorityPreemptive::PriorityPreemptive(TraceReader& trace) {
+    mTimeCounter = 0;
+    mTimeQuantum = 1; // 1 second.
+    mTrace = &trace;
+}
+
+// True if a process is still to arrive, which is then the front of
+// mProcessList. Jobs of a trace are read one at a time, when the schedule
+// reaches them.
+bool PriorityPreemptive::pending() {
+    TraceJob job;
+    if (mProcessList.empty() && mTrace != nullptr && mTrace->next(job)) {
+        Process process = {};
+        process.pid = job.pid;
+        process.arrivalTime = job.arrivalTime;
+        process.priority = job.priority;
+        process.burstTime = job.burstTime;
+        process.tempBurstTime = job.burstTime;
+        mProcessList.push(process);
+    }
+    return !mProcessList.empty();
+}
+
+// Processes are only picked at quantum boundaries, so a process arriving
+// at time waits for the first boundary at or after it.
+long long PriorityPreemptive::timeUntil(long long time) {
+    long long quanta = std::max<long long>(1, (time - mTimeCounter + mTimeQuantum - 1) / mTimeQuantum);
+    return quanta * mTimeQuantum;
+}
+
+// A slice continuing the previous one, of the same process without a
+// gap, is not a new entry.
+void PriorityPreemptive::addGanttEntry(int pid, long long sliceEnd) {
+    if (mTrace != nullptr) {
+        return; // Not kept for a trace
+    }
+    if (mGantChart.empty() || mGantChart.back().first != pid || sliceEnd != mTimeCounter) {
+        mGantChart.push_back({pid, mTimeCounter});
+    }
 }
 
 void PriorityPreemptive::scheduleProcess() {
+    // Event driven: time jumps straight to the next arrival, quantum expiry
+    // or completion, so the cost grows with the number of events, not with
+    // the time simulated.
+    long long sliceEnd = -1; // End of the previous slice
     // Keep scheduling until all processes are processed.
-    while (!mProcessList.empty() || !mRunningProcessList.empty()) {
+    while (pending() || !mRunningProcessList.empty()) {
+        // Nothing to run, skip to the next arrival.
+        if (mRunningProcessList.empty() && mTimeCounter < mProcessList.front().arrivalTime) {
+            mTimeCounter = mProcessList.front().arrivalTime;
+        }
+
         // If arrivalTime is less than mTimeCounter then load process into running Queue.
-        while (!mProcessList.empty() && mTimeCounter >= mProcessList.front().arrivalTime) {
+        while (pending() && mTimeCounter >= mProcessList.front().arrivalTime) {
             mRunningProcessList.addProcess(mProcessList.front());
             mProcessList.pop();
         }
 
-        if (!mRunningProcessList.empty()) {
-            // Fetch least burst time process into currentProcess
-            Process currentProcess = mRunningProcessList.getProcess();
+        // Fetch the highest priority process into currentProcess
+        Process currentProcess = mRunningProcessList.getProcess();
 
-            // Update starting time if required
-            if (currentProcess.init == false) {
-                currentProcess.startingTime = mTimeCounter;
-                currentProcess.init = true;
+        // Update starting time if required
+        if (currentProcess.init == false) {
+            currentProcess.startingTime = mTimeCounter;
+            currentProcess.init = true;
+        }
+        addGanttEntry(currentProcess.pid, sliceEnd); // Push process to gant chart.
+
+        // Process for a time quantum. With no other process of its priority
+        // or higher waiting, the quantum expiries before the next arrival
+        // change nothing, so it keeps running until then.
+        long long runTime = std::min(currentProcess.tempBurstTime, mTimeQuantum);
+        if (!mRunningProcessList.hasProcess(currentProcess.priority)) {
+            runTime = currentProcess.tempBurstTime;
+            if (pending()) {
+                runTime = std::min(runTime, timeUntil(mProcessList.front().arrivalTime));
             }
-            mGantChart.push_back({currentProcess.pid, mTimeCounter}); // Push process to gant chart.
-
-            if (currentProcess.tempBurstTime < mTimeQuantum) {
-                mTimeCounter += currentProcess.tempBurstTime;
-                currentProcess.tempBurstTime = 0;
+        }
+        currentProcess.tempBurstTime -= runTime;
+        mTimeCounter += runTime;
+        sliceEnd = mTimeCounter;
+
+        if (currentProcess.tempBurstTime == 0) {
+            currentProcess.finishingTime = mTimeCounter; // Update finishing time.
+            if (mTrace != nullptr) {
+                mStats.add(currentProcess.arrivalTime, currentProcess.burstTime, currentProcess.finishingTime);
             } else {
-                currentProcess.tempBurstTime -= mTimeQuantum; // Process for time quantum.
-                mTimeCounter += mTimeQuantum;
-            }
-
-            if (currentProcess.tempBurstTime == 0) {
-                currentProcess.finishingTime = mTimeCounter; // Update finishing time.
                 mFinishedProcesses.push_back(currentProcess);
-            } else {
-                // Add all the processes to the process list which
-                // comes during the processing of the current process.
-                for (int i = mTimeCounter - mTimeQuantum; i <= mTimeCounter; ++i) {
-                    if (!mProcessList.empty() && i >= mProcessList.front().arrivalTime) {
-                        mRunningProcessList.addProcess(mProcessList.front());
-                        mProcessList.pop();
-                    }
-                }
-
-                mRunningProcessList.addProcess(currentProcess);
             }
         } else {
-            mTimeCounter += mTimeQuantum;
+            // Add all the processes to the process list which
+            // comes during the processing of the current process.
+            while (pending() && mTimeCounter >= mProcessList.front().arrivalTime) {
+                mRunningProcessList.addProcess(mProcessList.front());
+                mProcessList.pop();
+            }
+
+            mRunningProcessList.addProcess(currentProcess);
         }
     }
 
@@ -168,10 +237,15 @@ void PriorityPreemptive::scheduleProcess() {
 
 void PriorityPreemptive::print() {
     scheduleProcess();
+    if (mTrace != nullptr) {
+        mStats.print(); // Summary only, a trace is too long for a table
+        return;
+    }
+
     std::cout << "P\tAT\tPr\tBT\tST\tFT\tTAT\tWT\n";
 
-    int waitingTime = 0;
-    int turnAroundTime = 0;
+    long long waitingTime = 0;
+    long long turnAroundTime = 0;
     for (auto& p : mFinishedProcesses) {
         std::cout << p.pid << '\t';
         std::cout << p.arrivalTime << '\t';
@@ -209,7 +283,13 @@ void PriorityPreemptive::printGanttChart() {
     std::cout << std::endl;
 }
 
-int main() {
+int main(int argc, char* argv[]) {
+    if (const char* path = traceArgument(argc, argv)) {
+        TraceReader trace(path);
+        PriorityPreemptive(trace).print();
+        return 0;
+    }
+
     // std::vector<Process> processList = {
     //    // pid, arrival time, priority, burst time
     //     {1, 0, 4, 4},
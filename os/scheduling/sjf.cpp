@@ -3,15 +3,17 @@
 #include <queue>
 #include <vector>
 
+#include "trace.h"
+
 // Process structure
 struct Process {
     int pid;
     int arrivalTime;
     int executionTime;
-    int startingTime;
-    int finishedTime;
-    int waitingTime;
-    int turnAroundTime;
+    long long startingTime;
+    long long finishedTime;
+    long long waitingTime;
+    long long turnAroundTime;
 };
 
 // Method to compare two proces for sorting purpose.
@@ -35,20 +37,25 @@ class ProcessComparator {
 
 class SJF {
   private:
-    int mTimer;
+    long long mTimer;
     std::priority_queue<Process, std::vector<Process>, ProcessComparator> mRunningProcess;
     std::queue<Process> mProcessList;
     std::vector<Process> mFinishedProcesses;
+    TraceReader* mTrace; // Jobs streamed from a trace, or nullptr
+    ScheduleStats mStats; // Of streamed jobs, which are not kept
+
+    bool pending();
 
   public:
     SJF(std::vector<Process>&);
+    SJF(TraceReader&);
     void scheduleProcess();
     void print();
     void printGanttChart();
 };
 
 // SJF Constructor
-SJF::SJF(std::vector<Process>& processes) : mTimer(0) {
+SJF::SJF(std::vector<Process>& processes) : mTimer(0), mTrace(nullptr) {
     // Sort process list
     std::sort(processes.begin(), processes.end(), processCompare);
 
@@ -57,8 +64,25 @@ SJF::SJF(std::vector<Process>& processes) : mTimer(0) {
         mProcessList.push(p);
 }
 
+SJF::SJF(TraceReader& trace) : mTimer(0), mTrace(&trace) {}
+
+// True if a process is still to arrive, which is then the front of
+// mProcessList. Jobs of a trace are read one at a time, when the schedule
+// reaches them.
+bool SJF::pending() {
+    TraceJob job;
+    if (mProcessList.empty() && mTrace != nullptr && mTrace->next(job)) {
+        Process process = {};
+        process.pid = job.pid;
+        process.arrivalTime = job.arrivalTime;
+        process.executionTime = job.burstTime;
+        mProcessList.push(process);
+    }
+    return !mProcessList.empty();
+}
+
 void SJF::scheduleProcess() {
-    while (!mRunningProcess.empty() || !mProcessList.empty()) {
+    while (!mRunningProcess.empty() || pending()) {
         // If Running queue is empty the load a process from the queue.
         if (mRunningProcess.empty()) {
             mRunningProcess.push(mProcessList.front());
@@ -72,7 +96,7 @@ void SJF::scheduleProcess() {
 
         // Load all the processes into running queue whose arrival
         // is less than current timer.
-        while (!mProcessList.empty() && mProcessList.front().arrivalTime <= mTimer) {
+        while (pending() && mProcessList.front().arrivalTime <= mTimer) {
             mRunningProcess.push(mProcessList.front());
             mProcessList.pop();
         }
@@ -87,7 +111,11 @@ void SJF::scheduleProcess() {
         mTimer = currentProcess.finishedTime;
 
         // Send finished process to finished list.
-        mFinishedProcesses.push_back(currentProcess);
+        if (mTrace != nullptr) {
+            mStats.add(currentProcess.arrivalTime, currentProcess.executionTime, currentProcess.finishedTime);
+        } else {
+            mFinishedProcesses.push_back(currentProcess);
+        }
     }
 
     for (Process& p : mFinishedProcesses) {
@@ -98,10 +126,15 @@ void SJF::scheduleProcess() {
 
 void SJF::print() {
     scheduleProcess();
+    if (mTrace != nullptr) {
+        mStats.print(); // Summary only, a trace is too long for a table
+        return;
+    }
+
     std::cout << "P\tAT\tBT\tST\tFT\tWT\tTAT\n";
 
-    int waitingTime = 0;
-    int turnAroundTime = 0;
+    long long waitingTime = 0;
+    long long turnAroundTime = 0;
     for (auto& process : mFinishedProcesses) {
         std::cout << process.pid << '\t';
         std::cout << process.arrivalTime << '\t';
@@ -141,6 +174,12 @@ void SJF::printGanttChart() {
 // Main function
 //----------------------------------------------------------------
 int main(int argc, char* argv[]) {
+    if (const char* path = traceArgument(argc, argv)) {
+        TraceReader trace(path);
+        SJF(trace).print();
+        return 0;
+    }
+
     std::vector<Process> processList = {
         // pid, arrival, execution
         {0,  2, 5},
@@ -5,22 +5,31 @@
 #include <utility>
 #include <vector>
 
+#include "trace.h"
+
 // Process structure
 struct Process {
     int pid;
     int arrivalTime;
     int burstTime;
     int tempBurstTime;
-    int startingTime;
-    int finishingTime;
-    int turnAroundTime;
-    int waitingTime;
+    long long startingTime;
+    long long finishingTime;
+    long long turnAroundTime;
+    long long waitingTime;
     bool init;
 };
 
 class TempBurstTimeCompare {
   public:
     bool operator()(Process& a, Process& b) {
+        // Ties go to the earlier arrival, so that the choice does not depend
+        // on the order of pushes into the heap
+        if (a.tempBurstTime == b.tempBurstTime) {
+            if (a.arrivalTime == b.arrivalTime)
+                return a.pid > b.pid;
+            return a.arrivalTime > b.arrivalTime;
+        }
         return a.tempBurstTime > b.tempBurstTime;
     }
 };
@@ -34,14 +43,22 @@ class SRTF {
     std::queue<Process> mProcessList; // Initially store all processes in queue.
     // Store running processes.
     std::priority_queue<Process, std::vector<Process>, TempBurstTimeCompare> mRunningProcessList;
-    std::vector<std::pair<int, int>> mGantChart; // <pid, time>
+    std::vector<std::pair<int, long long>> mGantChart; // <pid, time>
     std::vector<Process> mFinishedProcesses;
 
-    int mTimeCounter; // Running time counter.
+    long long mTimeCounter; // Running time counter.
     int mTimeQuantum; // Time limit for each process.
 
+    TraceReader* mTrace; // Jobs streamed from a trace, or nullptr
+    ScheduleStats mStats; // Of streamed jobs, which are not kept
+
+    bool pending();
+    long long timeUntil(long long time); // Time from now to the first quantum boundary at or after time
+    void addGanttEntry(int pid, long long sliceEnd);
+
   public:
     SRTF(std::vector<Process>&);
+    SRTF(TraceReader&);
     void scheduleProcess();
     void print();
     void printGanttChart();
@@ -59,45 +76,96 @@ SRTF::SRTF(std::vector<Process>& processList) {
 
     mTimeCounter = 0;
     mTimeQuantum = 1; // 1 second.
+    mTrace = nullptr;
+}
+
+SRTF::SRTF(TraceReader& trace) {
+    mTimeCounter = 0;
+    mTimeQuantum = 1; // 1 second.
+    mTrace = &trace;
+}
+
+// True if a process is still to arrive, which is then the front of
+// mProcessList. Jobs of a trace are read one at a time, when the schedule
+// reaches them.
+bool SRTF::pending() {
+    TraceJob job;
+    if (mProcessList.empty() && mTrace != nullptr && mTrace->next(job)) {
+        Process process = {};
+        process.pid = job.pid;
+        process.arrivalTime = job.arrivalTime;
+        process.burstTime = job.burstTime;
+        process.tempBurstTime = job.burstTime;
+        mProcessList.push(process);
+    }
+    return !mProcessList.empty();
+}
+
+// Processes are only picked at quantum boundaries, so a process arriving
+// at time waits for the first boundary at or after it.
+long long SRTF::timeUntil(long long time) {
+    long long quanta = std::max<long long>(1, (time - mTimeCounter + mTimeQuantum - 1) / mTimeQuantum);
+    return quanta * mTimeQuantum;
+}
+
+// A slice continuing the previous one, of the same process without a
+// gap, is not a new entry.
+void SRTF::addGanttEntry(int pid, long long sliceEnd) {
+    if (mTrace != nullptr) {
+        return; // Not kept for a trace
+    }
+    if (mGantChart.empty() || mGantChart.back().first != pid || sliceEnd != mTimeCounter) {
+        mGantChart.push_back({pid, mTimeCounter});
+    }
 }
 
 void SRTF::scheduleProcess() {
+    // Event driven: time jumps straight to the next arrival or completion,
+    // so the cost grows with the number of events, not with the time
+    // simulated. Between arrivals the running process stays the one with
+    // the least remaining time, so it runs until it completes or the next arrival.
+    long long sliceEnd = -1; // End of the previous slice
     // Keep scheduling until all processes are processed.
-    while (!mProcessList.empty() || !mRunningProcessList.empty()) {
+    while (pending() || !mRunningProcessList.empty()) {
+        // Nothing to run, skip to the next arrival.
+        if (mRunningProcessList.empty() && mTimeCounter < mProcessList.front().arrivalTime) {
+            mTimeCounter = mProcessList.front().arrivalTime;
+        }
+
         // If arrivalTime is less than mTimeCounter then load process into running Queue.
-        while (!mProcessList.empty() && mTimeCounter >= mProcessList.front().arrivalTime) {
+        while (pending() && mTimeCounter >= mProcessList.front().arrivalTime) {
             mRunningProcessList.push(mProcessList.front());
             mProcessList.pop();
         }
 
-        if (!mRunningProcessList.empty()) {
-            // Fetch least burst time process into currentProcess
-            Process currentProcess = mRunningProcessList.top();
-            mRunningProcessList.pop();
+        // Fetch the least remaining time process into currentProcess
+        Process currentProcess = mRunningProcessList.top();
+        mRunningProcessList.pop();
 
-            // Update starting time if required
-            if (currentProcess.init == false) {
-                currentProcess.startingTime = mTimeCounter;
-                currentProcess.init = true;
-            }
-            mGantChart.push_back({currentProcess.pid, mTimeCounter}); // Push process to gant chart.
+        // Update starting time if required
+        if (currentProcess.init == false) {
+            currentProcess.startingTime = mTimeCounter;
+            currentProcess.init = true;
+        }
+        addGanttEntry(currentProcess.pid, sliceEnd); // Push process to gant chart.
 
-            if (currentProcess.tempBurstTime < mTimeQuantum) {
-                mTimeCounter += currentProcess.tempBurstTime;
-                currentProcess.tempBurstTime = 0;
+        long long runTime = currentProcess.tempBurstTime;
+        if (pending()) {
+            runTime = std::min(runTime, timeUntil(mProcessList.front().arrivalTime));
+        }
+        currentProcess.tempBurstTime -= runTime;
+        mTimeCounter += runTime;
+        sliceEnd = mTimeCounter;
+
+        if (currentProcess.tempBurstTime == 0) {
+            currentProcess.finishingTime = mTimeCounter; // Update finishing time.
+            if (mTrace != nullptr) {
+                mStats.add(currentProcess.arrivalTime, currentProcess.burstTime, currentProcess.finishingTime);
             } else {
-                currentProcess.tempBurstTime -= mTimeQuantum; // Process for time quantum.
-                mTimeCounter += mTimeQuantum;
-            }
-
-            if (currentProcess.tempBurstTime == 0) {
-                currentProcess.finishingTime = mTimeCounter; // Update finishing time.
                 mFinishedProcesses.push_back(currentProcess);
-            } else {
-                mRunningProcessList.push(currentProcess);
             }
         } else {
-            mTimeCounter += mTimeQuantum;
+            mRunningProcessList.push(currentProcess);
         }
     }
 
@@ -110,10 +178,15 @@ void SRTF::scheduleProcess() {
 
 void SRTF::print() {
     scheduleProcess();
+    if (mTrace != nullptr) {
+        mStats.print(); // Summary only, a trace is too long for a table
+        return;
+    }
+
     std::cout << "P\tAT\tBT\tST\tFT\tTAT\tWT\n";
 
-    int waitingTime = 0;
-    int turnAroundTime = 0;
+    long long waitingTime = 0;
+    long long turnAroundTime = 0;
     for (auto& p : mFinishedProcesses) {
         std::cout << p.pid << '\t';
         std::cout << p.arrivalTime << '\t';
@@ -150,7 +223,13 @@ void SRTF::printGanttChart() {
     std::cout << std::endl;
 }
 
-int main() {
+int main(int argc, char* argv[]) {
+    if (const char* path = traceArgument(argc, argv)) {
+        TraceReader trace(path);
+        SRTF(trace).print();
+        return 0;
+    }
+
     // std::vector<Process> processList = {
     //    // pid, arrival time, burst time
     //     {1, 0, 4, 4},
@@ -0,0 +1,152 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <algorithm>
+#include <charconv> // from_chars
+#include <climits>
+#include <cstdlib> // exit
+#include <fstream>
+#include <iostream>
+#include <string>
+
+// Job of a trace. Traces are CSV files with one job per line,
+//
+//   pid,arrival,burst[,priority]
+//
+// in arrival order, as written by workload.cpp. A first line that does not
+// start with a digit is a header; empty lines and lines starting with #
+// are skipped. A missing priority is 0, the highest.
+struct TraceJob {
+    int pid;
+    int arrivalTime;
+    int burstTime;
+    int priority;
+};
+
+// Reads a trace one job at a time, so a scheduler holds only the jobs
+// that have arrived and not yet finished, whatever the trace size.
+class TraceReader {
+  private:
+    std::string mPath;
+    std::ifstream mFile;
+    std::istream* mInput;
+    std::string mLine;
+    long long mLineNumber;
+    int mLastArrival;
+
+    void fail(const std::string& message);
+    bool parse(const char*& pos, const char* end, int& value);
+
+  public:
+    explicit TraceReader(const std::string& path); // "-" = standard input
+
+    bool next(TraceJob& job); // Next job, false at the end of the trace
+};
+
+inline TraceReader::TraceReader(const std::string& path)
+    : mPath(path), mInput(&std::cin), mLineNumber(0), mLastArrival(INT_MIN) {
+    if (path != "-") {
+        mFile.open(path);
+        if (!mFile) {
+            std::cerr << "Error: Unable to open trace " << path << ".\n";
+            std::exit(1);
+        }
+        mInput = &mFile;
+    }
+}
+
+inline void TraceReader::fail(const std::string& message) {
+    std::cerr << "Error: " << mPath << ":" << mLineNumber << ": " << message << ".\n";
+    std::exit(1);
+}
+
+// Parse one integer field and the comma after it, if any
+inline bool TraceReader::parse(const char*& pos, const char* end, int& value) {
+    while (pos < end && *pos == ' ') {
+        ++pos;
+    }
+    std::from_chars_result result = std::from_chars(pos, end, value);
+    if (result.ec != std::errc()) {
+        return false;
+    }
+    pos = result.ptr;
+    while (pos < end && (*pos == ' ' || *pos == '\r')) {
+        ++pos;
+    }
+    if (pos < end && *pos == ',') {
+        ++pos;
+    }
+    return true;
+}
+
+inline bool TraceReader::next(TraceJob& job) {
+    while (std::getline(*mInput, mLine)) {
+        ++mLineNumber;
+        if (mLine.empty() || mLine[0] == '#' || mLine[0] == '\r' ||
+            (mLineNumber == 1 && (mLine[0] < '0' || mLine[0] > '9'))) {
+            continue;
+        }
+
+        const char* pos = mLine.data();
+        const char* end = pos + mLine.size();
+        job.priority = 0;
+        if (!parse(pos, end, job.pid) || !parse(pos, end, job.arrivalTime) || !parse(pos, end, job.burstTime) ||
+            (pos < end && !parse(pos, end, job.priority)) || pos != end) {
+            fail("Expected pid,arrival,burst[,priority]");
+        }
+        if (job.arrivalTime < 0 || job.burstTime < 0) {
+            fail("Negative time");
+        }
+        if (job.priority < 0) {
+            fail("Negative priority");
+        }
+        if (job.arrivalTime < mLastArrival) {
+            fail("Jobs out of arrival order");
+        }
+        mLastArrival = job.arrivalTime;
+        return true;
+    }
+    return false;
+}
+
+// Summary of a schedule, kept instead of the per-process table when jobs
+// are streamed from a trace
+struct ScheduleStats {
+    long long jobs = 0;
+    long long totalWaiting = 0;
+    long long totalTurnAround = 0;
+    long long maxWaiting = 0;
+    long long lastFinish = 0;
+
+    void add(long long arrivalTime, long long burstTime, long long finishTime) {
+        long long turnAround = finishTime - arrivalTime;
+        ++jobs;
+        totalWaiting += turnAround - burstTime;
+        totalTurnAround += turnAround;
+        maxWaiting = std::max(maxWaiting, turnAround - burstTime);
+        lastFinish = std::max(lastFinish, finishTime);
+    }
+
+    void print() const {
+        std::cout << "Jobs: " << jobs << std::endl;
+        std::cout << "Average waiting time: " << (jobs > 0 ? double(totalWaiting) / jobs : 0) << std::endl;
+        std::cout << "Average turn around time: " << (jobs > 0 ? double(totalTurnAround) / jobs : 0) << std::endl;
+        std::cout << "Maximum waiting time: " << maxWaiting << std::endl;
+        std::cout << "Last completion: " << lastFinish << std::endl;
+    }
+};
+
+// Trace named by --trace on the command line, or nullptr to run the
+// built-in example
+inline const char* traceArgument(int argc, char* argv[]) {
+    if (argc == 1) {
+        return nullptr;
+    }
+    if (argc == 3 && std::string(argv[1]) == "--trace") {
+        return argv[2];
+    }
+    std::cerr << "Usage: " << argv[0] << " [--trace file.csv]   (- reads the trace from standard input)\n";
+    std::exit(1);
+}
+
+#endif
@@ -0,0 +1,275 @@
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstdlib> // exit
+#include <exception>
+#include <iostream>
+#include <random>
+#include <stdexcept> // invalid_argument
+#include <string>
+#include <vector>
+
+// Synthetic workload generator. Writes a trace of jobs in arrival order as
+// CSV (pid,arrival,burst,priority) to standard output, for the schedulers'
+// --trace option, e.g.
+//
+//   ./workload --jobs 10000000 --arrival bursty --service pareto | ./srtf --trace -
+//
+// Times are whole time units; generation streams, so any number of jobs
+// takes constant memory.
+
+const double PI = 3.14159265358979323846;
+
+enum class ArrivalProcess {
+    POISSON, // Exponential gaps at a constant rate
+    BURSTY, // Alternates between quiet and burst periods of exponential length (two-state MMPP)
+    DIURNAL // Rate follows a sine wave over each period
+};
+
+enum class ServiceDistribution {
+    EXPONENTIAL,
+    PARETO, // Heavy tailed: a few jobs take most of the time
+    BIMODAL // Mostly short jobs with a fraction of long ones
+};
+
+struct WorkloadConfig {
+    long long jobs = 1000;
+    unsigned seed = 1;
+
+    ArrivalProcess arrival = ArrivalProcess::POISSON;
+    double rate = 0.08; // Mean arrivals per time unit; with the default mean, an offered load of 0.8
+    double burstFactor = 10; // BURSTY: rate multiplier during a burst
+    double burstLength = 50; // BURSTY: mean burst period
+    double quietLength = 500; // BURSTY: mean quiet period
+    double period = 1440; // DIURNAL: length of a day
+    double amplitude = 0.8; // DIURNAL: swing of the rate around its mean, in [0, 1]
+
+    ServiceDistribution service = ServiceDistribution::EXPONENTIAL;
+    double mean = 10; // Mean burst time; of the short jobs for BIMODAL
+    double paretoShape = 1.5; // PARETO: tail index, heavier below 2, infinite mean at 1 or less
+    double longFraction = 0.1; // BIMODAL: share of long jobs
+    double longMean = 100; // BIMODAL: mean burst time of long jobs
+
+    int priorities = 1; // Priorities 0 (highest) .. priorities - 1
+    double prioritySkew = 0; // Weight of priority k is 1 / (k + 1)^skew; 0 = uniform
+};
+
+class WorkloadGenerator {
+  private:
+    WorkloadConfig mConfig;
+    std::mt19937_64 mRandom;
+    std::uniform_real_distribution<double> mUniform; // [0, 1)
+    std::discrete_distribution<int> mPriority;
+
+    double mTime; // Arrival time of the last job
+    bool mBurst; // BURSTY: in a burst period
+    double mPeriodEnd; // BURSTY: end of the current period
+    long long mGenerated;
+
+    double exponential(double mean);
+    double nextArrival();
+    int nextBurst();
+
+  public:
+    explicit WorkloadGenerator(const WorkloadConfig& config);
+
+    bool next(int& pid, int& arrival, int& burst, int& priority); // False after config.jobs jobs
+};
+
+WorkloadGenerator::WorkloadGenerator(const WorkloadConfig& config)
+    : mConfig(config), mRandom(config.seed), mUniform(0, 1), mTime(0), mBurst(false), mPeriodEnd(0),
+      mGenerated(0) {
+    std::vector<double> weights;
+    for (int k = 0; k < std::max(1, config.priorities); ++k) {
+        weights.push_back(1 / std::pow(k + 1, config.prioritySkew));
+    }
+    mPriority = std::discrete_distribution<int>(weights.begin(), weights.end());
+    mPeriodEnd = exponential(config.quietLength);
+}
+
+double WorkloadGenerator::exponential(double mean) {
+    return -mean * std::log(1 - mUniform(mRandom)); // 1 - U is in (0, 1]
+}
+
+double WorkloadGenerator::nextArrival() {
+    switch (mConfig.arrival) {
+    case ArrivalProcess::BURSTY:
+        // Gaps are memoryless, so a gap that crosses the end of a period
+        // is simply drawn again at the rate of the next one
+        for (;;) {
+            double rate = mBurst ? mConfig.rate * mConfig.burstFactor : mConfig.rate;
+            double time = mTime + exponential(1 / rate);
+            if (time < mPeriodEnd) {
+                return time;
+            }
+            mTime = mPeriodEnd;
+            mBurst = !mBurst;
+            mPeriodEnd += exponential(mBurst ? mConfig.burstLength : mConfig.quietLength);
+        }
+    case ArrivalProcess::DIURNAL: {
+        // Thinning: candidates at the peak rate, each kept with the ratio
+        // of the rate at its time to the peak
+        double peak = mConfig.rate * (1 + mConfig.amplitude);
+        double time = mTime;
+        for (;;) {
+            time += exponential(1 / peak);
+            double rate = mConfig.rate * (1 + mConfig.amplitude * std::sin(2 * PI * time / mConfig.period));
+            if (mUniform(mRandom) * peak < rate) {
+                return time;
+            }
+        }
+    }
+    case ArrivalProcess::POISSON:
+    default:
+        return mTime + exponential(1 / mConfig.rate);
+    }
+}
+
+int WorkloadGenerator::nextBurst() {
+    double burst;
+    switch (mConfig.service) {
+    case ServiceDistribution::PARETO: {
+        // Scale chosen for the configured mean, where there is one
+        double alpha = mConfig.paretoShape;
+        double scale = alpha > 1 ? mConfig.mean * (alpha - 1) / alpha : mConfig.mean;
+        burst = scale / std::pow(1 - mUniform(mRandom), 1 / alpha);
+        break;
+    }
+    case ServiceDistribution::BIMODAL:
+        burst = exponential(mUniform(mRandom) < mConfig.longFraction ? mConfig.longMean : mConfig.mean);
+        break;
+    case ServiceDistribution::EXPONENTIAL:
+    default:
+        burst = exponential(mConfig.mean);
+        break;
+    }
+    return static_cast<int>(std::min<double>(INT_MAX, std::max(1.0, std::round(burst)))); // At least one unit
+}
+
+bool WorkloadGenerator::next(int& pid, int& arrival, int& burst, int& priority) {
+    if (mGenerated == mConfig.jobs) {
+        return false;
+    }
+
+    mTime = nextArrival();
+    if (mTime >= INT_MAX) {
+        std::cerr << "Error: Arrival times past " << INT_MAX << " after " << mGenerated << " jobs, use a higher rate.\n";
+        std::exit(1);
+    }
+    pid = static_cast<int>(++mGenerated);
+    arrival = static_cast<int>(mTime); // Non-decreasing, as mTime is
+    burst = nextBurst();
+    priority = mPriority(mRandom);
+    return true;
+}
+
+void printUsage(const char* program) {
+    std::cerr << "Usage: " << program << " [options] > trace.csv\n"
+              << "Options:\n"
+              << "  --jobs n              Jobs to generate (default 1000)\n"
+              << "  --seed n              Random seed (default 1)\n"
+              << "  --arrival process     poisson (default), bursty or diurnal\n"
+              << "  --rate r              Mean arrivals per time unit (default 0.08)\n"
+              << "  --burst-factor f      bursty: rate multiplier in a burst (default 10)\n"
+              << "  --burst-length t      bursty: mean burst period (default 50)\n"
+              << "  --quiet-length t      bursty: mean quiet period (default 500)\n"
+              << "  --period t            diurnal: length of a day (default 1440)\n"
+              << "  --amplitude a         diurnal: rate swing in [0, 1] (default 0.8)\n"
+              << "  --service dist        Burst times: exponential (default), pareto or bimodal\n"
+              << "  --mean t              Mean burst time, of the short jobs for bimodal (default 10)\n"
+              << "  --pareto-shape a      pareto: tail index (default 1.5)\n"
+              << "  --long-fraction p     bimodal: share of long jobs (default 0.1)\n"
+              << "  --long-mean t         bimodal: mean burst time of long jobs (default 100)\n"
+              << "  --priorities n        Priorities 0 (highest) to n - 1 (default 1)\n"
+              << "  --priority-skew s     Weight of priority k is 1 / (k + 1)^s, 0 = uniform (default 0)\n";
+}
+
+int main(int argc, char* argv[]) {
+    WorkloadConfig config;
+    try {
+        for (int i = 1; i < argc; ++i) {
+            std::string option = argv[i];
+            if (i + 1 >= argc) {
+                throw std::invalid_argument(option);
+            }
+
+            std::string value = argv[++i];
+            if (option == "--jobs") {
+                config.jobs = std::stoll(value);
+            } else if (option == "--seed") {
+                config.seed = std::stoul(value);
+            } else if (option == "--arrival") {
+                if (value == "poisson") {
+                    config.arrival = ArrivalProcess::POISSON;
+                } else if (value == "bursty") {
+                    config.arrival = ArrivalProcess::BURSTY;
+                } else if (value == "diurnal") {
+                    config.arrival = ArrivalProcess::DIURNAL;
+                } else {
+                    throw std::invalid_argument(option + " " + value);
+                }
+            } else if (option == "--rate") {
+                config.rate = std::stod(value);
+            } else if (option == "--burst-factor") {
+                config.burstFactor = std::stod(value);
+            } else if (option == "--burst-length") {
+                config.burstLength = std::stod(value);
+            } else if (option == "--quiet-length") {
+                config.quietLength = std::stod(value);
+            } else if (option == "--period") {
+                config.period = std::stod(value);
+            } else if (option == "--amplitude") {
+                config.amplitude = std::min(1.0, std::max(0.0, std::stod(value)));
+            } else if (option == "--service") {
+                if (value == "exponential") {
+                    config.service = ServiceDistribution::EXPONENTIAL;
+                } else if (value == "pareto") {
+                    config.service = ServiceDistribution::PARETO;
+                } else if (value == "bimodal") {
+                    config.service = ServiceDistribution::BIMODAL;
+                } else {
+                    throw std::invalid_argument(option + " " + value);
+                }
+            } else if (option == "--mean") {
+                config.mean = std::stod(value);
+            } else if (option == "--pareto-shape") {
+                config.paretoShape = std::stod(value);
+            } else if (option == "--long-fraction") {
+                config.longFraction = std::stod(value);
+            } else if (option == "--long-mean") {
+                config.longMean = std::stod(value);
+            } else if (option == "--priorities") {
+                config.priorities = std::max(1, std::stoi(value));
+            } else if (option == "--priority-skew") {
+                config.prioritySkew = std::stod(value);
+            } else {
+                throw std::invalid_argument(option);
+            }
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Error: Invalid option " << e.what() << ".\n";
+        printUsage(argv[0]);
+        std::exit(1);
+    }
+    if (config.rate <= 0 || config.burstFactor <= 0 || config.burstLength <= 0 || config.quietLength <= 0 ||
+        config.period <= 0 || config.mean <= 0 || config.paretoShape <= 0 || config.longMean <= 0) {
+        std::cerr << "Error: Rates, lengths, means and the Pareto shape must be positive.\n";
+        std::exit(1);
+    }
+
+    std::ios::sync_with_stdio(false); // Millions of lines
+    WorkloadGenerator generator(config);
+    long long totalBurst = 0;
+    int pid, arrival = 0, burst, priority;
+    std::cout << "pid,arrival,burst,priority\n";
+    while (generator.next(pid, arrival, burst, priority)) {
+        std::cout << pid << ',' << arrival << ',' << burst << ',' << priority << '\n';
+        totalBurst += burst;
+    }
+    std::cout.flush();
+
+    // Offered load above 1 means the queue grows without bound
+    std::cerr << config.jobs << " jobs over " << arrival << " time units, offered load "
+              << (arrival > 0 ? double(totalBurst) / arrival : 0) << "\n";
+    return 0;
+}